@@ -0,0 +1,74 @@
+#include <cmath>
+#include <limits>
+
+#include "../../../shared/bench/bench.h"
+#include "../src/core/voice/dsp.h"
+#include "../src/core/voice/frame.h"
+
+#define FRAMES 200000
+
+using namespace quesync;
+
+int main() {
+    int16_t pcm[FRAME_SIZE], converted[FRAME_SIZE];
+    float samples[FRAME_SIZE];
+
+    for (int i = 0; i < FRAME_SIZE; i++) {
+        pcm[i] = (int16_t)(12000 * std::sin(i * 0.05));
+    }
+
+    std::cout << "Capture DSP kernels per " << FRAME_SIZE << " samples frame"
+              << (client::voice::dsp::avx2() ? ", AVX2 available" : "") << "\n";
+
+    // The kernels used by the capture thread
+    double to_float = bench::measure(FRAMES, [&](std::size_t) {
+        client::voice::dsp::to_float(samples, pcm, FRAME_SIZE);
+
+        return samples[FRAME_SIZE - 1];
+    });
+    double to_int16 = bench::measure(FRAMES, [&](std::size_t) {
+        client::voice::dsp::to_int16(converted, samples, FRAME_SIZE);
+
+        return converted[FRAME_SIZE - 1];
+    });
+    double square_sum = bench::measure(FRAMES, [&](std::size_t) {
+        return client::voice::dsp::square_sum(pcm, FRAME_SIZE);
+    });
+
+    // The scalar loops the capture thread used before the kernels
+    double to_float_scalar = bench::measure(FRAMES, [&](std::size_t) {
+        for (int i = 0; i < FRAME_SIZE; i++) {
+            samples[i] = pcm[i];
+        }
+
+        return samples[FRAME_SIZE - 1];
+    });
+    double to_int16_scalar = bench::measure(FRAMES, [&](std::size_t) {
+        for (int i = 0; i < FRAME_SIZE; i++) {
+            converted[i] = (int16_t)samples[i];
+        }
+
+        return converted[FRAME_SIZE - 1];
+    });
+    double rms_scalar = bench::measure(FRAMES, [&](std::size_t) {
+        const float max_value = std::numeric_limits<int16_t>::max();
+        double square_sum = 0;
+        float relative_value;
+
+        for (int i = 0; i < FRAME_SIZE; i++) {
+            relative_value = pcm[i] / max_value;
+            square_sum += relative_value * relative_value;
+        }
+
+        return square_sum * 1000;
+    });
+
+    bench::report("int16 to float, SIMD", to_float, "ns");
+    bench::report("int16 to float, scalar", to_float_scalar, "ns");
+    bench::report("float to int16, SIMD", to_int16, "ns");
+    bench::report("float to int16, scalar", to_int16_scalar, "ns");
+    bench::report("Square sum, SIMD", square_sum, "ns");
+    bench::report("Square sum, scalar double precision", rms_scalar, "ns");
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../../../shared/bench/bench.h"
+#include "../src/core/voice/frame.h"
+#include "../src/core/voice/mixer.h"
+
+#define CALLBACKS 20000
+
+using namespace quesync;
+
+/**
+ * Adds a frame to a mix with saturation one sample at a time, the reference for the SIMD mixer.
+ *
+ * @param mix The mix buffer.
+ * @param pcm The frame to add to the mix.
+ * @param gain The fixed point gain of the frame.
+ */
+static void add_scalar(int16_t *mix, const int16_t *pcm, int16_t gain) {
+    for (int i = 0; i < FRAME_SIZE; i++) {
+        mix[i] = (int16_t)std::clamp<int32_t>(mix[i] + ((pcm[i] * gain) >> MIXER_GAIN_SHIFT),
+                                              std::numeric_limits<int16_t>::min(),
+                                              std::numeric_limits<int16_t>::max());
+    }
+}
+
+int main() {
+    std::vector<std::vector<int16_t>> streams;
+    int16_t mix[FRAME_SIZE], output[FRAME_SIZE * PLAYBACK_CHANNELS];
+    int16_t gain = client::voice::mixer::fixed_gain(0.8f);
+
+    // Decoded frames of the speakers
+    for (unsigned int s = 0; s < 32; s++) {
+        streams.emplace_back(FRAME_SIZE);
+        for (int i = 0; i < FRAME_SIZE; i++) {
+            streams[s][i] = (int16_t)(12000 * std::sin(i * (s + 1) * 0.02));
+        }
+    }
+
+    std::cout << "Playback callback mixing per " << FRAME_SIZE << " samples frame, the deadline is "
+              << FRAME_SIZE * 1000 / RECORD_FREQUENCY << " ms\n";
+
+    for (unsigned int speakers : {2, 4, 8, 16, 32}) {
+        // The playback callback sums the frames of all the speakers and upmixes the result
+        double simd = bench::measure(CALLBACKS, [&](std::size_t) {
+            std::fill(mix, mix + FRAME_SIZE, 0);
+            for (unsigned int s = 0; s < speakers; s++) {
+                client::voice::mixer::add(mix, streams[s].data(), gain, FRAME_SIZE);
+            }
+            client::voice::mixer::upmix(output, mix, FRAME_SIZE, PLAYBACK_CHANNELS);
+
+            return output[FRAME_SIZE];
+        });
+
+        double scalar = bench::measure(CALLBACKS, [&](std::size_t) {
+            std::fill(mix, mix + FRAME_SIZE, 0);
+            for (unsigned int s = 0; s < speakers; s++) {
+                add_scalar(mix, streams[s].data(), gain);
+            }
+            for (int i = 0; i < FRAME_SIZE; i++) {
+                for (int channel = 0; channel < PLAYBACK_CHANNELS; channel++) {
+                    output[i * PLAYBACK_CHANNELS + channel] = mix[i];
+                }
+            }
+
+            return output[FRAME_SIZE];
+        });
+
+        bench::report(std::to_string(speakers) + " streams, SIMD", simd, "ns");
+        bench::report(std::to_string(speakers) + " streams, scalar", scalar, "ns");
+    }
+
+    return 0;
+}
@@ -14,15 +14,19 @@
 #include "../../../../shared/utils/parser.h"
 
 quesync::client::modules::communicator::communicator(std::shared_ptr<client> client)
-    : module(client), _socket(nullptr), _stop_threads(true) {}
+    : module(client),
+      _multiplexed(false),
+      _next_request_id(1),
+      _socket(nullptr),
+      _stop_threads(true) {}
 
 void quesync::client::modules::communicator::clean_connection(bool join_recv_thread) {
     // Signal the threads to stop
     _stop_threads = true;
 
-    // Wake up the threads
+    // Wake up the threads, multiplexed requests may be waiting on several threads
     _events_cv.notify_one();
-    _response_cv.notify_one();
+    _response_cv.notify_all();
 
     // If the socket is connected, close the connection
     if (_socket && _socket->lowest_layer().is_open()) {
@@ -74,6 +78,7 @@ void quesync::client::modules::communicator::connect(std::string server_ip) {
 
     packets::ping_packet ping_packet;
     std::string res;
+    header res_header;
 
     // Check if already connected to the wanted server
     if (_socket && _server_ip == server_ip) {
@@ -106,8 +111,10 @@ void quesync::client::modules::communicator::connect(std::string server_ip) {
     }
 
     try {
-        // Send to the server the ping packet
-        socket_manager::send(*_socket, ping_packet.encode());
+        // Send to the server the ping packet in the multiplexed revision, servers that don't
+        // support it respond in the original revision
+        socket_manager::send(*_socket, ping_packet.encode(),
+                             header::multiplexed_version(next_request_id()));
     } catch (exception &ex) {
         clean_connection();
 
@@ -116,7 +123,7 @@ void quesync::client::modules::communicator::connect(std::string server_ip) {
 
     try {
         // Get from the server the response
-        res = socket_manager::recv(*_socket);
+        res = socket_manager::recv(*_socket, &res_header);
     } catch (exception &ex) {
         clean_connection();
 
@@ -138,6 +145,11 @@ void quesync::client::modules::communicator::connect(std::string server_ip) {
     // Save the server IP
     _server_ip = server_ip;
 
+    // If the server responded in the multiplexed revision, requests don't wait for each other
+    _multiplexed = res_header.revision() == PROTOCOL_MULTIPLEXED_VERSION;
+    _multiplexed_responses.clear();
+    _pending_requests.clear();
+
     // Stop signaling threads to exit
     _stop_threads = false;
 
@@ -173,6 +185,7 @@ void quesync::client::modules::communicator::recv() {
         std::shared_ptr<response_packet> response_packet;
 
         std::string buf;
+        header res_header;
 
         // If the socket isn't connected or all threads to be exited, quit the thread
         if (_stop_threads || !_socket || !_socket->lowest_layer().is_open()) {
@@ -181,7 +194,7 @@ void quesync::client::modules::communicator::recv() {
 
         try {
             // Get a response from the server
-            buf = socket_manager::recv(*_socket);
+            buf = socket_manager::recv(*_socket, &res_header);
         } catch (...) {
             // Clean the connection if the server is disconnected
             clean_connection(false);
@@ -206,6 +219,16 @@ void quesync::client::modules::communicator::recv() {
 
             // Notify the events handler thread that there is new events waiting to be handled
             _events_cv.notify_one();
+        } else if (_multiplexed) {
+            std::unique_lock<std::mutex> lk(_socket_get_mutex);
+
+            // Save the response by the ID of it's request, unless no one waits for it anymore
+            if (_pending_requests.count(res_header.request_id())) {
+                _multiplexed_responses[res_header.request_id()] = response_packet;
+            }
+
+            // Notify the waiting threads, each of them checks for it's own request
+            _response_cv.notify_all();
         } else {
             std::unique_lock<std::mutex> lk(_socket_get_mutex);
 
@@ -239,6 +262,35 @@ void quesync::client::modules::communicator::keep_alive() {
             break;
         }
 
+        // If the server supports multiplexing, the ping doesn't wait for other requests
+        if (_multiplexed) {
+            send_clock = std::clock();
+
+            try {
+                response_packet = send_multiplexed(ping_packet.encode());
+            } catch (...) {
+                continue;
+            }
+
+            if (_stop_threads) {
+                break;
+            }
+
+            recv_clock = std::clock();
+
+            // If the response is a pong packet, call the ping event
+            if (response_packet && response_packet->type() == packet_type::pong_packet) {
+                try {
+                    _event_handler.call_event(std::static_pointer_cast<event>(
+                        std::make_shared<events::ping_event>(ms_diff(recv_clock, send_clock))));
+                } catch (...) {
+                    // Ignore errors
+                }
+            }
+
+            continue;
+        }
+
         // Lock the socket's locks
         std::lock(get_lk, send_lk);
 
@@ -323,6 +375,35 @@ std::shared_ptr<quesync::response_packet> quesync::client::modules::communicator
 
     std::shared_ptr<response_packet> response_packet;
 
+    // If the server supports multiplexing, send the request without waiting for other requests
+    if (_multiplexed) {
+        try {
+            response_packet = send_multiplexed(packet->encode());
+        } catch (exception &ex) {
+            // Clean the connection
+            clean_connection();
+
+            // Call the clean callback
+            _client->clean_connection();
+
+            // Re-throw the exception
+            throw ex;
+        }
+
+        // If requested to stop all threads, throw error
+        if (!response_packet) {
+            throw exception(error::no_connection);
+        }
+
+        // If the response packet is an error packet, throw
+        if (response_packet->type() == packet_type::error_packet) {
+            throw exception(
+                std::static_pointer_cast<packets::error_packet>(response_packet)->error());
+        }
+
+        return response_packet;
+    }
+
     // Lock the socket's locks
     std::lock(get_lk, send_lk);
 
@@ -367,6 +448,69 @@ std::shared_ptr<quesync::response_packet> quesync::client::modules::communicator
     return response_packet;
 }
 
+std::shared_ptr<quesync::response_packet>
+quesync::client::modules::communicator::send_multiplexed(std::string data) {
+    std::unique_lock<std::mutex> get_lk(_socket_get_mutex, std::defer_lock);
+    std::shared_ptr<response_packet> response_packet;
+    uint32_t request_id;
+
+    {
+        std::lock_guard send_lk(_socket_send_mutex);
+
+        // If the socket isn't connected, throw error
+        if (!_socket) {
+            throw exception(error::no_connection);
+        }
+
+        request_id = next_request_id();
+
+        // Wait for the response of the request before it can arrive
+        get_lk.lock();
+        _pending_requests.insert(request_id);
+        get_lk.unlock();
+
+        // Send to the server the packet with the ID of the request
+        try {
+            socket_manager::send(*_socket, data, header::multiplexed_version(request_id));
+        } catch (...) {
+            get_lk.lock();
+            _pending_requests.erase(request_id);
+
+            throw;
+        }
+    }
+
+    get_lk.lock();
+
+    // Wait for the response of the request
+    _response_cv.wait(get_lk, [&, this] {
+        return !!_stop_threads || _multiplexed_responses.count(request_id);
+    });
+
+    // Stop waiting for the request and take it's response if it arrived
+    _pending_requests.erase(request_id);
+    auto it = _multiplexed_responses.find(request_id);
+    if (it != _multiplexed_responses.end()) {
+        response_packet = it->second;
+        _multiplexed_responses.erase(it);
+    }
+
+    // If requested to stop all threads, there is no response
+    if (_stop_threads) {
+        return nullptr;
+    }
+
+    return response_packet;
+}
+
+uint32_t quesync::client::modules::communicator::next_request_id() {
+    // Request IDs start at 1 and skip 0 when they wrap, since 0 is kept for events
+    uint32_t request_id = _next_request_id;
+    _next_request_id = _next_request_id % PROTOCOL_MAX_REQUEST_ID + 1;
+
+    return request_id;
+}
+
 std::shared_ptr<quesync::response_packet> quesync::client::modules::communicator::send_and_verify(
     quesync::serialized_packet *packet, quesync::packet_type response_type) {
     std::shared_ptr<response_packet> response_packet;
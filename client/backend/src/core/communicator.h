@@ -4,8 +4,10 @@
 #include <atomic>
 #include <condition_variable>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <thread>
 
 #include "../../../../shared/packets/event_packet.h"
@@ -84,6 +86,18 @@ class communicator : public module {
     /// The incoming response packets queue.
     std::vector<std::shared_ptr<response_packet>> _response_packets;
 
+    /// The incoming responses of the multiplexed revision by the ID of their request.
+    std::map<uint32_t, std::shared_ptr<response_packet>> _multiplexed_responses;
+
+    /// The IDs of the multiplexed requests that wait for their response.
+    std::set<uint32_t> _pending_requests;
+
+    /// Does the server support the multiplexed revision of the protocol.
+    bool _multiplexed;
+
+    /// The ID of the next multiplexed request.
+    uint32_t _next_request_id;
+
     /// Socker recv lock
     std::mutex _socket_get_mutex;
 
@@ -116,6 +130,9 @@ class communicator : public module {
     void recv();
     void events_handler();
 
+    std::shared_ptr<response_packet> send_multiplexed(std::string data);
+    uint32_t next_request_id();
+
     /// Should the threads stop.
     std::atomic<bool> _stop_threads;
 
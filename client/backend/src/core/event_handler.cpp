@@ -5,13 +5,19 @@
 
 void quesync::client::event_handler::call_event(std::shared_ptr<quesync::event> evt) {
     try {
-        // Call the core event handler
-        _core_event_handlers[evt->type](evt);
+        // Call the core event handler if the event has one
+        if (_core_event_handlers.count(evt->type)) {
+            _core_event_handlers[evt->type](evt);
+        }
     } catch (...) {
     }
 
-    // Check for no event handlers
+    // Check for no event handlers, events that only the core handles don't need one
     if (!_event_handlers.count(evt->type) || !_event_handlers[evt->type].size()) {
+        if (_core_event_handlers.count(evt->type)) {
+            return;
+        }
+
         throw std::runtime_error("No event handlers found for '" +
                                  static_cast<std::string>(magic_enum::enum_name(evt->type)) + "'");
     }
@@ -60,8 +60,8 @@ template void quesync::client::socket_manager::get_endpoint(const char *ip_addre
                                                             tcp::endpoint &endpoint);
 
 void quesync::client::socket_manager::send(asio::ssl::stream<tcp::socket> &socket,
-                                           std::string data) {
-    header header = {1, 0};
+                                           std::string data, uint32_t version) {
+    header header = {version, 0};
     std::string full_packet;
 
     // Set data size
@@ -81,7 +81,8 @@ void quesync::client::socket_manager::send(asio::ssl::stream<tcp::socket> &socke
     }
 }
 
-std::string quesync::client::socket_manager::recv(asio::ssl::stream<tcp::socket> &socket) {
+std::string quesync::client::socket_manager::recv(asio::ssl::stream<tcp::socket> &socket,
+                                                  quesync::header *packet_header) {
     header header;
     char *header_buf = new char[sizeof(quesync::header)];
 
@@ -106,6 +107,11 @@ std::string quesync::client::socket_manager::recv(asio::ssl::stream<tcp::socket>
         throw exception(error::unknown_error);
     }
 
+    // Return the header to the caller
+    if (packet_header) {
+        *packet_header = header;
+    }
+
     return std::string(buf.get(), header.size);
 }
 
@@ -49,16 +49,20 @@ class socket_manager {
      *
      * @param socket The socket to send the packet to.
      * @param data The data of the packet to send to the server.
+     * @param version The version field of the packet's header.
      */
-    static void send(asio::ssl::stream<tcp::socket> &socket, std::string data);
+    static void send(asio::ssl::stream<tcp::socket> &socket, std::string data,
+                     uint32_t version = PROTOCOL_VERSION);
 
     /**
      * Receive a packet from a socket.
      *
      * @param socket The socket to get a packet from.
+     * @param packet_header An optional pointer to fill with the header of the packet.
      * @return The data of the packet received.
      */
-    static std::string recv(asio::ssl::stream<tcp::socket> &socket);
+    static std::string recv(asio::ssl::stream<tcp::socket> &socket,
+                            header *packet_header = nullptr);
 
     /**
      * Generates error object for ASIO system error.
@@ -2,6 +2,8 @@
 
 #include "client.h"
 
+#include "../../../../shared/events/voice_group_key_event.h"
+#include "../../../../shared/events/voice_state_event.h"
 #include "../../../../shared/packets/call_request_packet.h"
 #include "../../../../shared/packets/get_channel_calls_packet.h"
 #include "../../../../shared/packets/join_call_request_packet.h"
@@ -9,17 +11,19 @@
 #include "../../../../shared/packets/set_voice_state_packet.h"
 #include "../../../../shared/utils/crypto/base64.h"
 #include "../../../../shared/utils/memory.h"
+#include "../../../../shared/voice_header.h"
 
 quesync::client::modules::voice::voice(std::shared_ptr<quesync::client::client> client)
     : module(client), _voice_manager(nullptr) {}
 
 std::shared_ptr<quesync::call_details> quesync::client::modules::voice::call(
-    std::string channel_id) {
+    std::string channel_id, bool group_key) {
     packets::call_request_packet call_request_packet;
 
     std::shared_ptr<response_packet> response_packet;
 
     std::shared_ptr<unsigned char> aes_key, hmac_key;
+    std::shared_ptr<utils::crypto::aead> aead;
     std::string otp;
 
     std::shared_ptr<call_details> call_details;
@@ -30,8 +34,8 @@ std::shared_ptr<quesync::call_details> quesync::client::modules::voice::call(
     }
 
     // Init call packet
-    call_request_packet =
-        packets::call_request_packet(channel_id, _voice_manager->muted(), _voice_manager->deafen());
+    call_request_packet = packets::call_request_packet(
+        channel_id, _voice_manager->muted(), _voice_manager->deafen(), VOICE_CIPHER_GCM, group_key);
 
     // Send to the server the call request
     response_packet = _client->communicator()->send_and_verify(&call_request_packet,
@@ -44,14 +48,37 @@ std::shared_ptr<quesync::call_details> quesync::client::modules::voice::call(
         utils::crypto::base64::decode(response_packet->json()["voiceSessionHMACKey"]));
     otp = utils::crypto::base64::decode(response_packet->json()["voiceSessionOTP"]);
 
+    // If the server accepted AES256-GCM, create the AEAD context of the stream
+    aead = response_packet->json().value("voiceCipher", VOICE_CIPHER_CBC_HMAC) == VOICE_CIPHER_GCM
+               ? std::make_shared<utils::crypto::aead>(aes_key.get(), VOICE_CLIENT_NONCE_PREFIX)
+               : nullptr;
+
+    // If the call uses a group key, set it before the voice starts
+    if (response_packet->json().count("voiceGroupKey")) {
+        _voice_manager->set_group_key(
+            utils::crypto::base64::decode(response_packet->json()["voiceGroupKey"]),
+            response_packet->json()["voiceGroupKeyEpoch"],
+            response_packet->json()["voiceGroupNoncePrefix"]);
+    } else {
+        _voice_manager->clear_group_key();
+    }
+
     // Enable the voice
-    _voice_manager->enable(response_packet->json()["voiceSessionId"], channel_id, aes_key, hmac_key,
-                           otp);
+    _voice_manager->enable(response_packet->json()["voiceSessionId"],
+                           response_packet->json().value("voiceStreamId", 0u), channel_id, aes_key,
+                           hmac_key, aead, otp);
 
     // Parse the call details
     call_details = std::make_shared<quesync::call_details>(
         response_packet->json()["callDetails"].get<quesync::call_details>());
 
+    // Save the voice streams of the participants
+    for (auto &voice_state : call_details->voice_states) {
+        if (voice_state.second.stream_id()) {
+            _voice_manager->set_stream_user(voice_state.second.stream_id(), voice_state.first);
+        }
+    }
+
     return call_details;
 }
 
@@ -62,6 +89,7 @@ std::unordered_map<std::string, quesync::voice::state> quesync::client::modules:
     std::shared_ptr<response_packet> response_packet;
 
     std::shared_ptr<unsigned char> aes_key, hmac_key;
+    std::shared_ptr<utils::crypto::aead> aead;
     std::string otp;
 
     std::unordered_map<std::string, quesync::voice::state> voice_states;
@@ -73,7 +101,7 @@ std::unordered_map<std::string, quesync::voice::state> quesync::client::modules:
 
     // Init join call packet
     join_call_request_packet = packets::join_call_request_packet(
-        channel_id, _voice_manager->muted(), _voice_manager->deafen());
+        channel_id, _voice_manager->muted(), _voice_manager->deafen(), VOICE_CIPHER_GCM);
 
     // Send to the server the join call request
     response_packet = _client->communicator()->send_and_verify(
@@ -86,14 +114,37 @@ std::unordered_map<std::string, quesync::voice::state> quesync::client::modules:
         utils::crypto::base64::decode(response_packet->json()["voiceSessionHMACKey"]));
     otp = utils::crypto::base64::decode(response_packet->json()["voiceSessionOTP"]);
 
+    // If the server accepted AES256-GCM, create the AEAD context of the stream
+    aead = response_packet->json().value("voiceCipher", VOICE_CIPHER_CBC_HMAC) == VOICE_CIPHER_GCM
+               ? std::make_shared<utils::crypto::aead>(aes_key.get(), VOICE_CLIENT_NONCE_PREFIX)
+               : nullptr;
+
+    // If the call uses a group key, set it before the voice starts
+    if (response_packet->json().count("voiceGroupKey")) {
+        _voice_manager->set_group_key(
+            utils::crypto::base64::decode(response_packet->json()["voiceGroupKey"]),
+            response_packet->json()["voiceGroupKeyEpoch"],
+            response_packet->json()["voiceGroupNoncePrefix"]);
+    } else {
+        _voice_manager->clear_group_key();
+    }
+
     // Enable the voice
-    _voice_manager->enable(response_packet->json()["voiceSessionId"], channel_id, aes_key, hmac_key,
-                           otp);
+    _voice_manager->enable(response_packet->json()["voiceSessionId"],
+                           response_packet->json().value("voiceStreamId", 0u), channel_id, aes_key,
+                           hmac_key, aead, otp);
 
     // Parse voice states
     voice_states = response_packet->json()["voiceStates"]
                        .get<std::unordered_map<std::string, quesync::voice::state>>();
 
+    // Save the voice streams of the participants
+    for (auto &voice_state : voice_states) {
+        if (voice_state.second.stream_id()) {
+            _voice_manager->set_stream_user(voice_state.second.stream_id(), voice_state.first);
+        }
+    }
+
     return voice_states;
 }
 
@@ -185,6 +236,18 @@ void quesync::client::modules::voice::set_output_device(unsigned int device_id)
     }
 }
 
+void quesync::client::modules::voice::set_user_gain(std::string user_id, float gain) {
+    if (_voice_manager) {
+        _voice_manager->set_user_gain(user_id, gain);
+    }
+}
+
+void quesync::client::modules::voice::set_voice_detection(bool enabled) {
+    if (_voice_manager) {
+        _voice_manager->set_voice_detection(enabled);
+    }
+}
+
 void quesync::client::modules::voice::clean_connection() {
     // If the voice manager is initated, delete it
     if (_voice_manager) {
@@ -205,4 +268,35 @@ void quesync::client::modules::voice::logged_out() {
 void quesync::client::modules::voice::connected(std::string server_ip) {
     _voice_manager = std::make_shared<quesync::client::voice::manager>(_client, server_ip.c_str());
     _voice_manager->init();
+
+    // Save the voice stream of each participant that joins the call
+    _client->communicator()->event_handler().register_core_event_handler(
+        event_type::voice_state_event, [this](std::shared_ptr<event> evt) {
+            std::shared_ptr<events::voice_state_event> voice_state_event =
+                std::static_pointer_cast<events::voice_state_event>(evt);
+
+            if (_voice_manager && voice_state_event->voice_state.stream_id()) {
+                _voice_manager->set_stream_user(voice_state_event->voice_state.stream_id(),
+                                                voice_state_event->user_id);
+            }
+        });
+
+    // Replace the group key of the call when the server rotates it
+    _client->communicator()->event_handler().register_core_event_handler(
+        event_type::voice_group_key_event, [this](std::shared_ptr<event> evt) {
+            std::shared_ptr<events::voice_group_key_event> group_key_event =
+                std::static_pointer_cast<events::voice_group_key_event>(evt);
+            std::shared_ptr<const quesync::client::voice::group_key> group;
+
+            if (!_voice_manager || _voice_manager->channel_id() != group_key_event->channel_id) {
+                return;
+            }
+
+            // Keep the nonce prefix the user got when joining the call
+            group = _voice_manager->group();
+            if (group) {
+                _voice_manager->set_group_key(group_key_event->key, group_key_event->epoch,
+                                              group->nonce_prefix);
+            }
+        });
 }
\ No newline at end of file
@@ -25,9 +25,11 @@ class voice : public module {
      * Start a call in a channel.
      *
      * @param channel_id The id of the channel to start a call in.
+     * @param group_key Should the call use a single group key instead of per-stream keys. Group
+     *                  key calls are relayed without re-encryption but are never mixed.
      * @return A shared pointer to the call details object.
      */
-    std::shared_ptr<call_details> call(std::string channel_id);
+    std::shared_ptr<call_details> call(std::string channel_id, bool group_key = false);
 
     /**
      * Join an existing call in a channel.
@@ -90,6 +92,22 @@ class voice : public module {
      */
     void set_output_device(unsigned int device_id);
 
+    /**
+     * Sets the gain of a user's voice.
+     *
+     * @param user_id The id of the user.
+     * @param gain The linear gain of the user's voice, 1 keeps the volume as is.
+     */
+    void set_user_gain(std::string user_id, float gain);
+
+    /**
+     * Sets the voice detection mode of the input.
+     *
+     * @param enabled Should the transmission be gated by voice detection instead of a dB
+     *                threshold.
+     */
+    void set_voice_detection(bool enabled);
+
     virtual void clean_connection();
     virtual void logged_out();
     virtual void connected(std::string server_ip);
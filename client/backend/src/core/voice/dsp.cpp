@@ -0,0 +1,246 @@
+#include "dsp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef DSP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+void to_float_scalar(float *out, const int16_t *in, unsigned int i, unsigned int samples) {
+    for (; i < samples; i++) {
+        out[i] = in[i];
+    }
+}
+
+void to_int16_scalar(int16_t *out, const float *in, unsigned int i, unsigned int samples) {
+    for (; i < samples; i++) {
+        out[i] = (int16_t)std::clamp<float>(std::nearbyint(in[i]),
+                                            std::numeric_limits<int16_t>::min(),
+                                            std::numeric_limits<int16_t>::max());
+    }
+}
+
+uint64_t square_sum_scalar(const int16_t *in, unsigned int i, unsigned int samples) {
+    uint64_t sum = 0;
+
+    for (; i < samples; i++) {
+        sum += (uint64_t)(in[i] * in[i]);
+    }
+
+    return sum;
+}
+
+#ifdef DSP_X86
+DSP_AVX2 void to_float_avx2(float *out, const int16_t *in, unsigned int samples) {
+    unsigned int i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+                                      _mm_loadu_si128((const __m128i *)(in + i)))));
+    }
+
+    to_float_scalar(out, in, i, samples);
+}
+
+DSP_AVX2 void to_int16_avx2(int16_t *out, const float *in, unsigned int samples) {
+    unsigned int i = 0;
+
+    for (; i + 16 <= samples; i += 16) {
+        // Pack with saturation, the pack works on each 128-bit lane so the lanes are reordered
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_loadu_ps(in + i)),
+                                            _mm256_cvtps_epi32(_mm256_loadu_ps(in + i + 8)));
+
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+
+    to_int16_scalar(out, in, i, samples);
+}
+
+DSP_AVX2 uint64_t square_sum_avx2(const int16_t *in, unsigned int samples) {
+    __m256i sum = _mm256_setzero_si256();
+    unsigned int i = 0;
+    uint64_t lanes[4];
+
+    for (; i + 16 <= samples; i += 16) {
+        __m256i samples_vec = _mm256_loadu_si256((const __m256i *)(in + i));
+
+        // Each pair of squares fits an unsigned 32-bit integer, widen them before summing
+        __m256i pairs = _mm256_madd_epi16(samples_vec, samples_vec);
+        sum = _mm256_add_epi64(sum, _mm256_unpacklo_epi32(pairs, _mm256_setzero_si256()));
+        sum = _mm256_add_epi64(sum, _mm256_unpackhi_epi32(pairs, _mm256_setzero_si256()));
+    }
+
+    _mm256_storeu_si256((__m256i *)lanes, sum);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + square_sum_scalar(in, i, samples);
+}
+
+void to_float_sse2(float *out, const int16_t *in, unsigned int samples) {
+    unsigned int i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128i samples_vec = _mm_loadu_si128((const __m128i *)(in + i));
+
+        // Sign extend the samples by shifting them to the top of 32-bit integers and back
+        _mm_storeu_ps(out + i, _mm_cvtepi32_ps(_mm_srai_epi32(
+                                   _mm_unpacklo_epi16(_mm_setzero_si128(), samples_vec), 16)));
+        _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(_mm_srai_epi32(
+                                       _mm_unpackhi_epi16(_mm_setzero_si128(), samples_vec), 16)));
+    }
+
+    to_float_scalar(out, in, i, samples);
+}
+
+void to_int16_sse2(int16_t *out, const float *in, unsigned int samples) {
+    unsigned int i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        _mm_storeu_si128((__m128i *)(out + i),
+                         _mm_packs_epi32(_mm_cvtps_epi32(_mm_loadu_ps(in + i)),
+                                         _mm_cvtps_epi32(_mm_loadu_ps(in + i + 4))));
+    }
+
+    to_int16_scalar(out, in, i, samples);
+}
+
+uint64_t square_sum_sse2(const int16_t *in, unsigned int samples) {
+    __m128i sum = _mm_setzero_si128();
+    unsigned int i = 0;
+    uint64_t lanes[2];
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128i samples_vec = _mm_loadu_si128((const __m128i *)(in + i));
+
+        // Each pair of squares fits an unsigned 32-bit integer, widen them before summing
+        __m128i pairs = _mm_madd_epi16(samples_vec, samples_vec);
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(pairs, _mm_setzero_si128()));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(pairs, _mm_setzero_si128()));
+    }
+
+    _mm_storeu_si128((__m128i *)lanes, sum);
+
+    return lanes[0] + lanes[1] + square_sum_scalar(in, i, samples);
+}
+#elif defined(__ARM_NEON)
+void to_float_neon(float *out, const int16_t *in, unsigned int samples) {
+    unsigned int i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t samples_vec = vld1q_s16(in + i);
+
+        vst1q_f32(out + i, vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples_vec))));
+        vst1q_f32(out + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples_vec))));
+    }
+
+    to_float_scalar(out, in, i, samples);
+}
+
+void to_int16_neon(int16_t *out, const float *in, unsigned int samples) {
+    unsigned int i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        // Round to nearest by adding half away from zero before the truncating conversion
+        float32x4_t lo = vld1q_f32(in + i), hi = vld1q_f32(in + i + 4);
+        lo = vaddq_f32(lo, vbslq_f32(vcltq_f32(lo, vdupq_n_f32(0)), vdupq_n_f32(-0.5f),
+                                     vdupq_n_f32(0.5f)));
+        hi = vaddq_f32(hi, vbslq_f32(vcltq_f32(hi, vdupq_n_f32(0)), vdupq_n_f32(-0.5f),
+                                     vdupq_n_f32(0.5f)));
+
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(lo)),
+                                        vqmovn_s32(vcvtq_s32_f32(hi))));
+    }
+
+    to_int16_scalar(out, in, i, samples);
+}
+
+uint64_t square_sum_neon(const int16_t *in, unsigned int samples) {
+    uint64x2_t sum = vdupq_n_u64(0);
+    unsigned int i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t samples_vec = vld1q_s16(in + i);
+
+        // Each square fits an unsigned 32-bit integer, widen them before summing
+        sum = vpadalq_u32(sum, vreinterpretq_u32_s32(vmull_s16(vget_low_s16(samples_vec),
+                                                               vget_low_s16(samples_vec))));
+        sum = vpadalq_u32(sum, vreinterpretq_u32_s32(vmull_s16(vget_high_s16(samples_vec),
+                                                               vget_high_s16(samples_vec))));
+    }
+
+    return vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1) + square_sum_scalar(in, i, samples);
+}
+#endif
+};  // namespace
+
+void quesync::client::voice::dsp::to_float(float *out, const int16_t *in, unsigned int samples) {
+#ifdef DSP_X86
+    if (avx2()) {
+        to_float_avx2(out, in, samples);
+    } else {
+        to_float_sse2(out, in, samples);
+    }
+#elif defined(__ARM_NEON)
+    to_float_neon(out, in, samples);
+#else
+    to_float_scalar(out, in, 0, samples);
+#endif
+}
+
+void quesync::client::voice::dsp::to_int16(int16_t *out, const float *in, unsigned int samples) {
+#ifdef DSP_X86
+    if (avx2()) {
+        to_int16_avx2(out, in, samples);
+    } else {
+        to_int16_sse2(out, in, samples);
+    }
+#elif defined(__ARM_NEON)
+    to_int16_neon(out, in, samples);
+#else
+    to_int16_scalar(out, in, 0, samples);
+#endif
+}
+
+uint64_t quesync::client::voice::dsp::square_sum(const int16_t *in, unsigned int samples) {
+#ifdef DSP_X86
+    if (avx2()) {
+        return square_sum_avx2(in, samples);
+    } else {
+        return square_sum_sse2(in, samples);
+    }
+#elif defined(__ARM_NEON)
+    return square_sum_neon(in, samples);
+#else
+    return square_sum_scalar(in, 0, samples);
+#endif
+}
+
+bool quesync::client::voice::dsp::avx2() {
+    static const bool supported = [] {
+#if defined(DSP_X86) && defined(_MSC_VER)
+        int info[4];
+
+        // Check that the OS saves the AVX registers and that the CPU supports AVX2
+        __cpuid(info, 1);
+        if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) {
+            return false;
+        }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#elif defined(DSP_X86)
+        return __builtin_cpu_supports("avx2") != 0;
+#else
+        return false;
+#endif
+    }();
+
+    return supported;
+}
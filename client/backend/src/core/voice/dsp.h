@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define DSP_X86
+#endif
+
+// Kernels marked with DSP_AVX2 are compiled for AVX2 regardless of the target, they may only be
+// called if dsp::avx2() returns true
+#if defined(DSP_X86) && defined(__GNUC__)
+#define DSP_AVX2 __attribute__((target("avx2")))
+#else
+#define DSP_AVX2
+#endif
+
+namespace quesync {
+namespace client {
+namespace voice {
+class dsp {
+   public:
+    /**
+     * Converts 16-bit samples to float samples of the same scale.
+     *
+     * @param out The buffer of the float samples.
+     * @param in The 16-bit samples.
+     * @param samples The amount of samples.
+     */
+    static void to_float(float *out, const int16_t *in, unsigned int samples);
+
+    /**
+     * Converts float samples to 16-bit samples with rounding and saturation.
+     *
+     * @param out The buffer of the 16-bit samples.
+     * @param in The float samples.
+     * @param samples The amount of samples.
+     */
+    static void to_int16(int16_t *out, const float *in, unsigned int samples);
+
+    /**
+     * Calculates the sum of the squares of 16-bit samples.
+     *
+     * @param in The 16-bit samples.
+     * @param samples The amount of samples.
+     * @return The sum of the squares of the samples.
+     */
+    static uint64_t square_sum(const int16_t *in, unsigned int samples);
+
+    /**
+     * Checks if the CPU supports AVX2, the result is detected once and cached.
+     *
+     * @return True if AVX2 is supported or false otherwise.
+     */
+    static bool avx2();
+};
+};  // namespace voice
+};  // namespace client
+};  // namespace quesync
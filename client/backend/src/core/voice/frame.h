@@ -0,0 +1,18 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#define RECORD_FREQUENCY 48000
+#define RECORD_CHANNELS 1
+#define PLAYBACK_CHANNELS 2
+#define FRAME_SIZE 480
+
+namespace quesync {
+namespace client {
+namespace voice {
+/// A mono frame of 16-bit PCM samples.
+typedef std::array<int16_t, FRAME_SIZE> pcm_frame;
+};  // namespace voice
+};  // namespace client
+};  // namespace quesync
@@ -1,9 +1,11 @@
 #include "input.h"
 
+#include <algorithm>
 #include <chrono>
 #include <limits>
 #include <sole.hpp>
 
+#include "dsp.h"
 #include "manager.h"
 
 #include "../../../shared/packets/voice_packet.h"
@@ -12,7 +14,19 @@
 #undef max  // Fix a conflict with windows.h's max macro
 
 quesync::client::voice::input::input(std::shared_ptr<manager> manager)
-    : _manager(manager), _enabled(false), _muted(false) {
+    : _manager(manager),
+      _overruns(0),
+      _packets(0),
+      _bytes(0),
+      _encoded_packets(0),
+      _encode_time(0),
+      _feedback{false, 0, 0, 0},
+      _bitrate(ADAPT_START_BITRATE),
+      _packet_frames(ADAPT_START_PACKET_FRAMES),
+      _enabled(false),
+      _muted(false),
+      _drop_input(false),
+      _voice_detection(true) {
     int opus_error = 0;
 
     // Create the opus encoder for the recording
@@ -23,6 +37,16 @@ quesync::client::voice::input::input(std::shared_ptr<manager> manager)
         exit(EXIT_FAILURE);
     }
 
+    // Start with a voice bitrate, the controller adapts it to the reports of the receivers
+    opus_encoder_ctl(_opus_encoder, OPUS_SET_BITRATE(_bitrate));
+
+    // Add FEC data of the previous frame to each packet so lost frames can be rebuilt
+    opus_encoder_ctl(_opus_encoder, OPUS_SET_INBAND_FEC(1));
+    opus_encoder_ctl(_opus_encoder, OPUS_SET_PACKET_LOSS_PERC(FEC_MIN_LOSS_PERC));
+
+    // Let the encoder drop frames of silence between words
+    opus_encoder_ctl(_opus_encoder, OPUS_SET_DTX(1));
+
     // Init RNNoise
     _rnnoise_state = rnnoise_create(NULL);
 
@@ -31,7 +55,10 @@ quesync::client::voice::input::input(std::shared_ptr<manager> manager)
 }
 
 quesync::client::voice::input::~input() {
-    // Wake the thread up
+    // Wake the thread up, the lock makes sure it's waiting or will see the stop flag
+    {
+        std::lock_guard lk(_data_mutex);
+    }
     _data_cv.notify_one();
 
     // If the input thread is still alive, join it
@@ -47,27 +74,49 @@ quesync::client::voice::input::~input() {
 }
 
 void quesync::client::voice::input::callback_handler(void *input_buffer) {
-    std::unique_lock lk(_data_mutex);
-    std::shared_ptr<int16_t> input_data(new int16_t[FRAME_SIZE]);
+    pcm_frame input_data;
 
     // Copy to input data
-    memcpy(input_data.get(), input_buffer, FRAME_SIZE * sizeof(int16_t));
+    memcpy(input_data.data(), input_buffer, FRAME_SIZE * sizeof(int16_t));
 
-    // Add the input data
-    _input_data.push(input_data);
+    // Add the input data, if the input thread fell behind drop the frame
+    if (!_input_data.push(input_data)) {
+        _overruns++;
+    }
 
-    // Notify the handle thread
-    lk.unlock();
+    // Notify the handle thread without taking it's lock
     _data_cv.notify_one();
 }
 
-void quesync::client::voice::input::enable() {
-    std::queue<std::shared_ptr<int16_t>> q;
+uint64_t quesync::client::voice::input::overruns() { return _overruns; }
+
+quesync::voice::stream_stats quesync::client::voice::input::stats() {
+    quesync::voice::stream_stats stats;
+    uint64_t encoded_packets = _encoded_packets;
 
-    // Swap with a clean queue to clean it
-    std::swap(q, _input_data);
+    stats.packets_out = _packets;
+    stats.bytes_out = _bytes;
+    if (encoded_packets) {
+        stats.codec_time = _encode_time / 1000.0 / encoded_packets;
+    }
 
-    _enabled = true;
+    return stats;
+}
+
+void quesync::client::voice::input::enable() {
+    // Clean the frames and the counters of the previous call, the frames are dropped by the input
+    // thread since it's the only consumer of the ring
+    _drop_input = true;
+    _packets = 0;
+    _bytes = 0;
+    _encoded_packets = 0;
+    _encode_time = 0;
+
+    {
+        std::lock_guard lk(_data_mutex);
+        _enabled = true;
+    }
+    _data_cv.notify_one();
 }
 
 void quesync::client::voice::input::disable() { _enabled = false; }
@@ -77,125 +126,273 @@ void quesync::client::voice::input::input_thread() {
     int16_t encoded_buffer[FRAME_SIZE] = {0};
 
     float rnnoise_buffer[FRAME_SIZE] = {0};
+    int16_t packet_buffer[FRAME_SIZE * MAX_PACKET_FRAMES] = {0};
 
     uint8_t current_db_sample = 0;
-    int16_t db_check_samples[FRAME_SIZE * (CHECK_DB_TIMEOUT / 10)];
+    uint64_t frame_square_sum = 0, db_square_sum = 0, packet_square_sum = 0;
     double db = 0;
-    uint64_t last_activated = _manager->get_ms();
+    float voice_probability = 0;
+    bool speech = false, transmit = false;
+    uint64_t last_activated = _manager->get_ms(), last_adapted = _manager->get_ms();
+    std::chrono::steady_clock::time_point encode_start;
 
-    packets::voice_packet voice_packet;
-    std::string voice_packet_encrypted;
+    uint16_t sequence = 0;
+    uint32_t timestamp = 0, packet_timestamp = 0;
+    unsigned int packet_frames = 0;
+
+    pcm_frame buffer;
 
     while (true) {
-        std::shared_ptr<int16_t> buffer;
+        // Wait for new input while enabled, the callback doesn't take the lock so the wait is
+        // bounded to recover from a notification that was missed
+        std::unique_lock lk(_data_mutex);
+        _data_cv.wait_for(lk, std::chrono::milliseconds(INPUT_WAIT_MS), [this] {
+            return _manager->stop_threads() || (_enabled && _input_data.size());
+        });
+        lk.unlock();
 
         // If all threads needs to be stopped
         if (_manager->stop_threads()) {
             break;
         }
 
+        // Drop the frames captured before the input was enabled
+        if (_drop_input.exchange(false)) {
+            _input_data.clear();
+        }
+
         // If disabled, skip
         if (!_enabled) {
-            std::this_thread::sleep_for(std::chrono::microseconds(750));
             continue;
         }
 
-        // Wait for new input
-        std::unique_lock lk(_data_mutex);
-        _data_cv.wait(lk, [&, this] { return !!_manager->stop_threads() || !_input_data.empty(); });
-        if (_manager->stop_threads()) {
-            break;
+        // Get input data
+        if (!_input_data.pop(buffer)) {
+            continue;
         }
 
-        // Get input data
-        buffer = _input_data.front();
-        _input_data.pop();
+        // Advance the timestamp for every captured frame so gaps in the stream are kept
+        timestamp += FRAME_SIZE;
 
-        // If muted, continue
+        // If muted, drop the current packet and continue
         if (_muted) {
+            packet_frames = 0;
+            packet_square_sum = 0;
+            transmit = false;
             continue;
         }
 
-        // Copy all PCM 16-bit short to an array of floats
-        for (int i = 0; i < FRAME_SIZE; i++) {
-            rnnoise_buffer[i] = ((opus_int16 *)buffer.get())[i];
-        }
+        // Convert the PCM 16-bit samples to floats for RNNoise
+        dsp::to_float(rnnoise_buffer, buffer.data(), FRAME_SIZE);
 
         // Process frame using RNNoise to reduce background noise
-        rnnoise_process_frame(_rnnoise_state, rnnoise_buffer, rnnoise_buffer);
+        voice_probability = rnnoise_process_frame(_rnnoise_state, rnnoise_buffer, rnnoise_buffer);
 
-        // Copy back the result data to the buffer
-        for (int i = 0; i < FRAME_SIZE; i++) {
-            ((opus_int16 *)buffer.get())[i] = (opus_int16)rnnoise_buffer[i];
-        }
+        // Convert back the result data to the buffer
+        dsp::to_int16(buffer.data(), rnnoise_buffer, FRAME_SIZE);
 
-        // Copy the current sample to the buffer of db check samples
-        for (int i = 0; i < FRAME_SIZE; i++) {
-            db_check_samples[current_db_sample * FRAME_SIZE + i] = buffer.get()[i];
-        }
+        // Measure the energy of the frame once for the db check and the audio level
+        frame_square_sum = dsp::square_sum(buffer.data(), FRAME_SIZE);
+        db_square_sum += frame_square_sum;
 
         // Check if reached the amount of samples needed for db check
         current_db_sample++;
         if (current_db_sample >= (CHECK_DB_TIMEOUT / 10)) {
+            // Calculate the db of the db check samples
+            db = calc_db(calc_rms(db_square_sum, FRAME_SIZE * (CHECK_DB_TIMEOUT / 10)));
+
             current_db_sample = 0;
+            db_square_sum = 0;
+        }
 
-            // Calculate the db of the db check samples
-            db = calc_db(calc_rms(db_check_samples, FRAME_SIZE * (CHECK_DB_TIMEOUT / 10)));
+        if (_voice_detection) {
+            // Speech needs both RNNoise's voice probability and enough energy, so keyboard and
+            // fan noise don't open the gate
+            speech = voice_probability >= VAD_PROBABILITY &&
+                     calc_db(calc_rms(frame_square_sum, FRAME_SIZE)) > MINIMUM_DB;
+        } else {
+            speech = db > MINIMUM_DB;
+        }
+
+        // If there is speech, set the last played time
+        if (speech) {
+            last_activated = _manager->get_ms();
         }
 
-        // If the current samples are over the minimum db or we are in the stop transition time
-        if (db > MINIMUM_DB || _manager->get_ms() - last_activated < VOICE_DEACTIVATE_DELAY) {
+        // The packet is transmitted if any of it's frames is speech or in the stop transition time
+        if (speech || _manager->get_ms() - last_activated <
+                          (_voice_detection ? VAD_HANGOVER_MS : VOICE_DEACTIVATE_DELAY)) {
+            transmit = true;
+        }
+
+        // Add the frame to the current packet
+        if (!packet_frames) {
+            packet_timestamp = timestamp;
+        }
+        memcpy(packet_buffer + packet_frames * FRAME_SIZE, buffer.data(),
+               FRAME_SIZE * sizeof(int16_t));
+        packet_square_sum += frame_square_sum;
+        packet_frames++;
+
+        // Wait for the rest of the packet's frames
+        if (packet_frames < _packet_frames) {
+            continue;
+        }
+
+        if (transmit) {
             // Activate the user's voice
             _manager->activate_voice(_manager->user_id());
 
-            // Encode the captured data
-            encodedDataLen =
-                opus_encode(_opus_encoder, (const opus_int16 *)buffer.get(), FRAME_SIZE,
-                            (unsigned char *)encoded_buffer, FRAME_SIZE * sizeof(opus_int16));
-
-            // Create the voice packet and encrypt it
-            voice_packet = packets::voice_packet(_manager->user_id(), _manager->session_id(),
-                                                 _manager->channel_id(), (char *)encoded_buffer,
-                                                 encodedDataLen);
-            voice_packet_encrypted = utils::encryption::encrypt_voice_packet(
-                &voice_packet, _manager->aes_key().get(), _manager->hmac_key().get());
-
-            try {
-                // Send the encoded voice packet to the server
-                _manager->socket().send_to(
-                    asio::buffer(voice_packet_encrypted.c_str(), voice_packet_encrypted.length()),
-                    _manager->endpoint());
-            } catch (...) {
-                break;
+            // Encode the frames of the packet together
+            encode_start = std::chrono::steady_clock::now();
+            encodedDataLen = opus_encode(
+                _opus_encoder, (const opus_int16 *)packet_buffer, packet_frames * FRAME_SIZE,
+                (unsigned char *)encoded_buffer, FRAME_SIZE * sizeof(opus_int16));
+            _encode_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - encode_start)
+                                .count();
+            _encoded_packets++;
+
+            // If the encoder dropped the packet as silence, don't send it
+            if (encodedDataLen > DTX_FRAME_MAX_LEN) {
+                try {
+                    // Send the encoded voice packet to the server
+                    send_packet(sequence++, packet_timestamp,
+                                calc_level(calc_rms(packet_square_sum, packet_frames * FRAME_SIZE)),
+                                (char *)encoded_buffer, encodedDataLen);
+                } catch (...) {
+                    break;
+                }
             }
+        }
 
-            // If the current samples are over the minimum db, set the last played time
-            if (db > MINIMUM_DB) {
-                last_activated = _manager->get_ms();
-            }
+        packet_frames = 0;
+        packet_square_sum = 0;
+        transmit = false;
+
+        // Adapt the encoder between packets so the packet duration changes on a packet boundary
+        if (_manager->get_ms() - last_adapted >= ADAPT_INTERVAL_MS) {
+            last_adapted = _manager->get_ms();
+            adapt_encoder();
         }
     }
 }
 
-double quesync::client::voice::input::calc_rms(int16_t *data, uint32_t size) {
-    double square_sum = 0, rms;
-    float relative_value;
+void quesync::client::voice::input::send_packet(uint16_t sequence, uint32_t timestamp,
+                                                uint8_t level, const char *data, int data_len) {
+    packets::voice_packet voice_packet(_manager->stream_id(), sequence, timestamp, level,
+                                       (char *)data, data_len);
+    std::string voice_packet_encrypted;
+    std::shared_ptr<utils::crypto::aead> aead = _manager->aead();
+    std::shared_ptr<const group_key> group = _manager->group();
+
+    // Encrypt the voice packet, once for all participants if the call uses a group key
+    if (group) {
+        voice_packet_encrypted = utils::encryption::encrypt_group_voice_packet(
+            &voice_packet, group->epoch, group->aead.get());
+    } else if (aead) {
+        voice_packet_encrypted = utils::encryption::encrypt_voice_packet(&voice_packet, aead.get());
+    } else {
+        voice_packet_encrypted = utils::encryption::encrypt_voice_packet(
+            &voice_packet, _manager->aes_key().get(), _manager->hmac_key().get());
+    }
+
+    _manager->socket().send_to(
+        asio::buffer(voice_packet_encrypted.c_str(), voice_packet_encrypted.length()),
+        _manager->endpoint());
+
+    _packets++;
+    _bytes += voice_packet_encrypted.length();
+}
+
+void quesync::client::voice::input::handle_report(const packets::voice_report_packet &report,
+                                                  uint32_t rtt) {
+    std::lock_guard lk(_feedback_mutex);
+
+    // Keep the worst path, the stream must be heard by all the receivers
+    _feedback.received = true;
+    _feedback.loss = std::max(_feedback.loss, report.loss() / 255.0f);
+    _feedback.jitter = std::max<unsigned int>(_feedback.jitter, report.jitter());
+    _feedback.rtt = std::max<unsigned int>(_feedback.rtt, rtt + report.rtt());
+}
 
-    const float max_value = std::numeric_limits<int16_t>::max();
+void quesync::client::voice::input::adapt_encoder() {
+    network_feedback feedback;
+    int bandwidth = 0;
 
-    for (unsigned int i = 0; i < size; i++) {
-        relative_value = data[i] / max_value;
-        square_sum += relative_value * relative_value;
+    // Take the feedback of the receivers since the last adaptation
+    {
+        std::lock_guard lk(_feedback_mutex);
+        feedback = _feedback;
+        _feedback = network_feedback{false, 0, 0, 0};
     }
 
-    rms = sqrt(square_sum / size);
-    return rms;
+    // Without reports, the loss of the received streams is the best estimate of the path
+    if (!feedback.received) {
+        feedback.loss = _manager->loss();
+    }
+
+    if (feedback.loss > ADAPT_CONGESTED_LOSS || feedback.jitter > ADAPT_CONGESTED_JITTER_MS ||
+        feedback.rtt > ADAPT_CONGESTED_RTT_MS) {
+        // Back off quickly under congestion, long packets also cut the packet rate and overhead
+        _bitrate = std::max(_bitrate * 3 / 4, ADAPT_MIN_BITRATE);
+        _packet_frames = MAX_PACKET_FRAMES;
+    } else {
+        // Probe back up slowly while the loss is low
+        if (feedback.loss < ADAPT_CLEAR_LOSS) {
+            _bitrate = std::min(_bitrate + _bitrate / 10, ADAPT_MAX_BITRATE);
+        }
+
+        // Short packets lower the delay only when the path is clear and close
+        _packet_frames = feedback.received && feedback.loss < ADAPT_CLEAR_LOSS &&
+                                 feedback.jitter < ADAPT_CLEAR_JITTER_MS &&
+                                 feedback.rtt < ADAPT_CLEAR_RTT_MS
+                             ? 1
+                             : ADAPT_START_PACKET_FRAMES;
+    }
+
+    // Narrow the audio bandwidth with the bitrate so the remaining bits keep the voice clear
+    if (_bitrate < 12000) {
+        bandwidth = OPUS_BANDWIDTH_NARROWBAND;
+    } else if (_bitrate < 20000) {
+        bandwidth = OPUS_BANDWIDTH_WIDEBAND;
+    } else if (_bitrate < 28000) {
+        bandwidth = OPUS_BANDWIDTH_SUPERWIDEBAND;
+    } else {
+        bandwidth = OPUS_BANDWIDTH_FULLBAND;
+    }
+
+    opus_encoder_ctl(_opus_encoder, OPUS_SET_BITRATE(_bitrate));
+    opus_encoder_ctl(_opus_encoder, OPUS_SET_MAX_BANDWIDTH(bandwidth));
+
+    // Tune the FEC to the reported loss
+    opus_encoder_ctl(_opus_encoder, OPUS_SET_PACKET_LOSS_PERC(std::clamp(
+                                        (int)ceil(feedback.loss * 100), FEC_MIN_LOSS_PERC,
+                                        FEC_MAX_LOSS_PERC)));
+}
+
+double quesync::client::voice::input::calc_rms(uint64_t square_sum, uint32_t size) {
+    const double max_value = std::numeric_limits<int16_t>::max();
+
+    // Normalize the RMS to full scale
+    return sqrt((double)square_sum / size) / max_value;
 }
 
 double quesync::client::voice::input::calc_db(double rms) { return 20 * log10(rms / AMP_REF); }
 
+uint8_t quesync::client::voice::input::calc_level(double rms) {
+    // The level is the attenuation from full scale in dB
+    double level = -20 * log10(rms);
+
+    return (uint8_t)std::min<double>(std::max<double>(level, 0), VOICE_LEVEL_SILENCE);
+}
+
 void quesync::client::voice::input::mute() { _muted = true; }
 
 void quesync::client::voice::input::unmute() { _muted = false; }
 
-bool quesync::client::voice::input::muted() { return _muted; }
\ No newline at end of file
+bool quesync::client::voice::input::muted() { return _muted; }
+
+void quesync::client::voice::input::set_voice_detection(bool enabled) {
+    _voice_detection = enabled;
+}
\ No newline at end of file
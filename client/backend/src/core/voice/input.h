@@ -1,23 +1,66 @@
 #pragma once
 #include <opus.h>
 #include <rnnoise.h>
+#include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
 #include <thread>
 
+#include "frame.h"
+#include "spsc_ring.h"
+
+#include "../../../shared/packets/voice_report_packet.h"
+#include "../../../shared/voice_stats.h"
+
 #define AMP_REF 0.00001
 #define CHECK_DB_TIMEOUT 30
 #define MINIMUM_DB 40
 #define VOICE_DEACTIVATE_DELAY 100
 
+#define VAD_PROBABILITY 0.6f
+#define VAD_HANGOVER_MS 300
+#define DTX_FRAME_MAX_LEN 2
+
+#define FEC_MIN_LOSS_PERC 2
+#define FEC_MAX_LOSS_PERC 30
+
+#define ADAPT_INTERVAL_MS 1000
+#define ADAPT_START_BITRATE 32000
+#define ADAPT_START_PACKET_FRAMES 2
+#define ADAPT_MIN_BITRATE 8000
+#define ADAPT_MAX_BITRATE 64000
+#define ADAPT_CONGESTED_LOSS 0.1f
+#define ADAPT_CONGESTED_JITTER_MS 60
+#define ADAPT_CONGESTED_RTT_MS 400
+#define ADAPT_CLEAR_LOSS 0.02f
+#define ADAPT_CLEAR_JITTER_MS 20
+#define ADAPT_CLEAR_RTT_MS 60
+#define MAX_PACKET_FRAMES 4
+
+#define INPUT_RING_FRAMES 16
+#define INPUT_WAIT_MS 10
+
 namespace quesync {
 namespace client {
 namespace voice {
 class manager;
 
+struct network_feedback {
+    /// Did any receiver report on the stream since the last adaptation.
+    bool received;
+
+    /// The worst loss rate reported.
+    float loss;
+
+    /// The worst jitter reported in milliseconds.
+    unsigned int jitter;
+
+    /// The worst round trip time to a receiver in milliseconds.
+    unsigned int rtt;
+};
+
 class input {
    public:
     /**
@@ -59,6 +102,22 @@ class input {
      */
     bool muted();
 
+    /**
+     * Sets the voice detection mode. When enabled, frames are transmitted only when RNNoise
+     * detects speech with enough energy, otherwise a dB threshold is used.
+     *
+     * @param enabled Should the voice detection be used.
+     */
+    void set_voice_detection(bool enabled);
+
+    /**
+     * Adds the report of a receiver to the feedback of the next encoder adaptation.
+     *
+     * @param report The report of the receiver on the user's stream.
+     * @param rtt The round trip time to the server in milliseconds.
+     */
+    void handle_report(const packets::voice_report_packet &report, uint32_t rtt);
+
     /**
      * Handles the callback from the audio framework.
      *
@@ -66,33 +125,78 @@ class input {
      */
     void callback_handler(void *input_buffer);
 
+    /**
+     * Get the amount of captured frames that were dropped because the input thread fell behind.
+     *
+     * @return The amount of dropped frames.
+     */
+    uint64_t overruns();
+
+    /**
+     * Get the statistics of the user's voice stream.
+     *
+     * @return The counters of the sent stream, the stream and user ids are left for the caller.
+     */
+    quesync::voice::stream_stats stats();
+
    private:
     /// A shared pointer to the voice manager object.
     std::shared_ptr<manager> _manager;
 
-    /// A queue of the input data buffers
-    std::queue<std::shared_ptr<int16_t>> _input_data;
+    /// The captured frames, filled by the audio callback and drained by the input thread.
+    spsc_ring<pcm_frame, INPUT_RING_FRAMES> _input_data;
     std::mutex _data_mutex;
     std::condition_variable _data_cv;
 
+    /// The amount of captured frames dropped because the ring was full.
+    std::atomic<uint64_t> _overruns;
+
+    /// The amount of packets and bytes sent.
+    std::atomic<uint64_t> _packets;
+    std::atomic<uint64_t> _bytes;
+
+    /// The amount of encoded packets and the total time it took to encode them in nanoseconds.
+    std::atomic<uint64_t> _encoded_packets;
+    std::atomic<uint64_t> _encode_time;
+
     std::thread _thread;
 
     /// A pointer to the opus encoder.
     OpusEncoder *_opus_encoder;
 
+    /// The feedback of the receivers since the last adaptation.
+    network_feedback _feedback;
+    std::mutex _feedback_mutex;
+
+    /// The current bitrate of the encoder.
+    int _bitrate;
+
+    /// The amount of frames sent in each packet.
+    unsigned int _packet_frames;
+
     /// A pointer to the RNNoise object.
     DenoiseState *_rnnoise_state;
 
     /// Is the input enabled.
-    bool _enabled;
+    std::atomic<bool> _enabled;
 
     // Is the input muted.
-    bool _muted;
+    std::atomic<bool> _muted;
+
+    /// Should the input thread drop the captured frames, set when the input is enabled.
+    std::atomic<bool> _drop_input;
+
+    /// Is the transmission gated by voice detection.
+    bool _voice_detection;
 
     void input_thread();
+    void adapt_encoder();
+    void send_packet(uint16_t sequence, uint32_t timestamp, uint8_t level, const char *data,
+                     int data_len);
 
-    double calc_rms(int16_t *data, uint32_t size);
+    double calc_rms(uint64_t square_sum, uint32_t size);
     double calc_db(double rms);
+    uint8_t calc_level(double rms);
 };
 };  // namespace voice
 };  // namespace client
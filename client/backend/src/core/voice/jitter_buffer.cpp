@@ -0,0 +1,243 @@
+#include "jitter_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "manager.h"
+#include "mixer.h"
+
+quesync::client::voice::jitter_buffer::jitter_buffer()
+    : _decoder(nullptr, &opus_decoder_destroy),
+      _next_sequence(0),
+      _highest_sequence(0),
+      _packet_frames(1),
+      _decoded_offset(0),
+      _decoded_size(0),
+      _started(false),
+      _playing(false),
+      _jitter(0),
+      _last_transit(0),
+      _target_delay(JITTER_MIN_DELAY_FRAMES),
+      _idle_frames(0),
+      _loss(0),
+      _packets(0),
+      _bytes(0),
+      _reordered(0),
+      _lost(0),
+      _decoded_packets(0),
+      _decode_time(0),
+      _gain(MIXER_GAIN_UNITY),
+      _epoch(std::chrono::steady_clock::now()) {
+    int opus_error = 0;
+
+    // Create the opus decoder of the stream
+    _decoder.reset(opus_decoder_create(RECORD_FREQUENCY, RECORD_CHANNELS, &opus_error));
+    if (opus_error != OPUS_OK) {
+        _decoder.reset();
+    }
+}
+
+void quesync::client::voice::jitter_buffer::push(const packets::voice_packet &packet) {
+    uint64_t sequence = 0;
+    int packet_samples = 0;
+
+    std::lock_guard lk(_mutex);
+
+    if (!_decoder || !packet.voice_data_len()) {
+        return;
+    }
+
+    // Extend the sequence number so it keeps increasing after it wraps around
+    if (!_started) {
+        sequence = _highest_sequence = (uint64_t)1 << 32 | packet.sequence();
+        _started = true;
+    } else {
+        sequence = _highest_sequence + (int16_t)(packet.sequence() - (uint16_t)_highest_sequence);
+        if (sequence < _highest_sequence) {
+            _reordered++;
+        }
+        _highest_sequence = std::max(_highest_sequence, sequence);
+    }
+
+    _packets++;
+    _bytes += packet.voice_data_len();
+
+    // Drop frames that arrived after their turn to play
+    if (_playing && sequence < _next_sequence) {
+        return;
+    }
+
+    update_jitter(packet.timestamp());
+
+    // Follow the packet duration of the sender, lost packets are concealed with the same duration
+    packet_samples = opus_packet_get_nb_samples((const unsigned char *)packet.voice_data(),
+                                                packet.voice_data_len(), RECORD_FREQUENCY);
+    if (packet_samples >= FRAME_SIZE) {
+        _packet_frames = std::min(packet_samples / FRAME_SIZE, JITTER_MAX_PACKET_FRAMES);
+    }
+
+    _frames[sequence] = std::string(packet.voice_data(), packet.voice_data_len());
+
+    // Bound the depth of the buffer by dropping the oldest frames
+    while (_frames.size() > JITTER_MAX_DEPTH_FRAMES) {
+        _frames.erase(_frames.begin());
+        _next_sequence = _frames.begin()->first;
+    }
+}
+
+bool quesync::client::voice::jitter_buffer::pop(int16_t *pcm) {
+    std::string frame;
+    bool lost = false, fec = false;
+    int frame_size = 0;
+    unsigned int target_delay = 0;
+    std::chrono::steady_clock::time_point decode_start;
+
+    // Play the rest of the current packet before taking the next one
+    if (_decoded_offset < _decoded_size) {
+        memcpy(pcm, _decoded + _decoded_offset, FRAME_SIZE * sizeof(int16_t));
+        _decoded_offset += FRAME_SIZE;
+
+        return true;
+    }
+
+    std::unique_lock lk(_mutex);
+
+    // At least a whole packet must be buffered
+    target_delay = std::max(_target_delay, _packet_frames);
+
+    // Buffer frames until the target delay is reached
+    if (!_playing) {
+        if (buffered_frames() < target_delay) {
+            _idle_frames++;
+            return false;
+        }
+
+        _playing = true;
+        _next_sequence = _frames.begin()->first;
+    }
+
+    // If the network caught up after a delay spike, drop the oldest frames to get back to the
+    // target delay
+    while (_frames.size() > 1 && buffered_frames() > target_delay + JITTER_MAX_EXCESS_FRAMES) {
+        _frames.erase(_frames.begin());
+        _next_sequence = _frames.begin()->first;
+    }
+
+    // If the buffer ran out, go back to buffering
+    if (_frames.empty()) {
+        _playing = false;
+        _idle_frames++;
+
+        return false;
+    }
+
+    // Take the next frame, if it's missing while later frames arrived it's lost
+    if (_frames.begin()->first == _next_sequence) {
+        frame = std::move(_frames.begin()->second);
+        _frames.erase(_frames.begin());
+    } else {
+        lost = true;
+
+        // If the frame after it arrived, rebuild the lost frame from it's FEC data
+        if (_frames.begin()->first == _next_sequence + 1) {
+            frame = _frames.begin()->second;
+            fec = true;
+        }
+    }
+    _next_sequence++;
+
+    // A lost packet is rebuilt with the duration of the last packet, a received one is decoded
+    // with whatever duration it has
+    frame_size = lost ? _packet_frames * FRAME_SIZE : FRAME_SIZE * JITTER_MAX_PACKET_FRAMES;
+
+    // The stream is playing again, reset it's idle frames while the lock is held
+    _idle_frames = 0;
+
+    lk.unlock();
+
+    _loss = _loss + ((lost ? 1 : 0) - _loss) * JITTER_LOSS_SMOOTHING;
+    if (lost) {
+        _lost++;
+    }
+
+    // Decode the packet, a lost packet without FEC data is concealed by the decoder
+    decode_start = std::chrono::steady_clock::now();
+    _decoded_offset = 0;
+    _decoded_size = opus_decode(_decoder.get(),
+                                frame.empty() ? nullptr : (const unsigned char *)frame.data(),
+                                (opus_int32)frame.size(), _decoded, frame_size, fec ? 1 : 0);
+    _decode_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - decode_start)
+                        .count();
+    _decoded_packets++;
+    if (_decoded_size < FRAME_SIZE || _decoded_size % FRAME_SIZE) {
+        _decoded_size = 0;
+        return false;
+    }
+
+    // Play the first frame of the packet
+    memcpy(pcm, _decoded, FRAME_SIZE * sizeof(int16_t));
+    _decoded_offset = FRAME_SIZE;
+
+    return true;
+}
+
+unsigned int quesync::client::voice::jitter_buffer::idle_frames() {
+    std::lock_guard lk(_mutex);
+
+    return _idle_frames;
+}
+
+float quesync::client::voice::jitter_buffer::loss() { return _loss; }
+
+double quesync::client::voice::jitter_buffer::jitter() {
+    std::lock_guard lk(_mutex);
+
+    return _jitter * 1000 / RECORD_FREQUENCY;
+}
+
+quesync::voice::stream_stats quesync::client::voice::jitter_buffer::stats() {
+    quesync::voice::stream_stats stats;
+
+    std::lock_guard lk(_mutex);
+
+    stats.packets_in = _packets;
+    stats.bytes_in = _bytes;
+    stats.lost = _lost;
+    stats.reordered = _reordered;
+    stats.jitter = _jitter * 1000 / RECORD_FREQUENCY;
+    stats.buffer_depth = buffered_frames();
+    if (_decoded_packets) {
+        stats.codec_time = _decode_time / 1000.0 / _decoded_packets;
+    }
+
+    return stats;
+}
+
+void quesync::client::voice::jitter_buffer::set_gain(int16_t gain) { _gain = gain; }
+
+int16_t quesync::client::voice::jitter_buffer::gain() { return _gain; }
+
+void quesync::client::voice::jitter_buffer::update_jitter(uint32_t timestamp) {
+    int64_t arrival = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - _epoch)
+                          .count() *
+                      RECORD_FREQUENCY / 1000000;
+    int64_t transit = arrival - timestamp;
+
+    // Estimate the inter-arrival jitter as described in RFC 3550
+    if (_last_transit) {
+        _jitter += (std::abs(transit - _last_transit) - _jitter) / JITTER_SMOOTHING;
+    }
+    _last_transit = transit;
+
+    // Buffer enough frames to absorb the jitter
+    _target_delay = std::clamp<unsigned int>(
+        (unsigned int)std::ceil(JITTER_DELAY_MULTIPLIER * _jitter / FRAME_SIZE),
+        JITTER_MIN_DELAY_FRAMES, JITTER_MAX_DELAY_FRAMES);
+}
+
+unsigned int quesync::client::voice::jitter_buffer::buffered_frames() {
+    return (unsigned int)_frames.size() * _packet_frames;
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <opus.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "frame.h"
+
+#include "../../../shared/packets/voice_packet.h"
+#include "../../../shared/voice_stats.h"
+
+#define JITTER_MIN_DELAY_FRAMES 1
+#define JITTER_MAX_DELAY_FRAMES 10
+#define JITTER_MAX_EXCESS_FRAMES 4
+#define JITTER_MAX_DEPTH_FRAMES 25
+#define JITTER_MAX_PACKET_FRAMES 4
+#define JITTER_DELAY_MULTIPLIER 3
+#define JITTER_SMOOTHING 16
+#define JITTER_LOSS_SMOOTHING 0.02f
+
+namespace quesync {
+namespace client {
+namespace voice {
+class jitter_buffer {
+   public:
+    /**
+     * Jitter buffer constructor.
+     */
+    jitter_buffer();
+
+    /**
+     * Queues a voice packet of the stream by it's sequence number.
+     *
+     * @param packet The voice packet.
+     */
+    void push(const packets::voice_packet &packet);
+
+    /**
+     * Decodes the next frame of the stream.
+     *
+     * @param pcm The buffer of the decoded frame, must fit a frame.
+     * @return True if a frame was decoded or false if the stream is buffering.
+     */
+    bool pop(int16_t *pcm);
+
+    /**
+     * Get the amount of frames since the stream last played.
+     *
+     * @return The amount of idle frames.
+     */
+    unsigned int idle_frames();
+
+    /**
+     * Get the smoothed loss rate of the stream.
+     *
+     * @return The fraction of the played frames that were lost.
+     */
+    float loss();
+
+    /**
+     * Get the estimated inter-arrival jitter of the stream.
+     *
+     * @return The jitter in milliseconds.
+     */
+    double jitter();
+
+    /**
+     * Get the statistics of the stream.
+     *
+     * @return The counters of the stream, the stream and user ids are left for the caller.
+     */
+    quesync::voice::stream_stats stats();
+
+    /**
+     * Sets the gain the stream is mixed with.
+     *
+     * @param gain The fixed point gain of the mixer.
+     */
+    void set_gain(int16_t gain);
+
+    /**
+     * Get the gain the stream is mixed with.
+     *
+     * @return The fixed point gain of the mixer.
+     */
+    int16_t gain();
+
+   private:
+    /// The decoder of the stream.
+    std::unique_ptr<OpusDecoder, decltype(&opus_decoder_destroy)> _decoder;
+
+    /// The received packets waiting to be played by their extended sequence number.
+    std::map<uint64_t, std::string> _frames;
+
+    /// The amount of frames in each packet of the stream, the sender changes it with the network.
+    unsigned int _packet_frames;
+
+    /// The decoded samples of the current packet that weren't played yet.
+    int16_t _decoded[FRAME_SIZE * JITTER_MAX_PACKET_FRAMES];
+    int _decoded_offset;
+    int _decoded_size;
+
+    /// The extended sequence number of the next frame to play.
+    uint64_t _next_sequence;
+
+    /// The highest extended sequence number received.
+    uint64_t _highest_sequence;
+
+    /// Did the stream receive any packet yet.
+    bool _started;
+
+    /// Is the stream playing or buffering until the target delay is reached.
+    bool _playing;
+
+    /// The estimated inter-arrival jitter of the stream in samples.
+    double _jitter;
+
+    /// The difference between the arrival time and the timestamp of the last packet in samples.
+    int64_t _last_transit;
+
+    /// The amount of frames buffered before playing.
+    unsigned int _target_delay;
+
+    /// The amount of frames since the stream last played.
+    unsigned int _idle_frames;
+
+    /// The smoothed fraction of the played frames that were lost.
+    std::atomic<float> _loss;
+
+    /// The amount of packets and bytes received.
+    uint64_t _packets;
+    uint64_t _bytes;
+
+    /// The amount of packets that arrived after a later packet.
+    uint64_t _reordered;
+
+    /// The amount of packets that were missing when their turn to play came.
+    std::atomic<uint64_t> _lost;
+
+    /// The amount of decoded packets and the total time it took to decode them in nanoseconds.
+    std::atomic<uint64_t> _decoded_packets;
+    std::atomic<uint64_t> _decode_time;
+
+    /// The fixed point gain the stream is mixed with.
+    std::atomic<int16_t> _gain;
+
+    /// The time the buffer was created, the arrival times are relative to it.
+    std::chrono::steady_clock::time_point _epoch;
+
+    std::mutex _mutex;
+
+    void update_jitter(uint32_t timestamp);
+    unsigned int buffered_frames();
+};
+};  // namespace voice
+};  // namespace client
+};  // namespace quesync
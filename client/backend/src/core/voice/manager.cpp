@@ -6,6 +6,7 @@
 #include "../client.h"
 
 #include "../../../shared/events/voice_activity_event.h"
+#include "../../../shared/events/voice_stats_event.h"
 #include "../../../shared/exception.h"
 #include "../../../shared/packets/voice_otp_packet.h"
 #include "../../../shared/packets/voice_packet.h"
@@ -28,10 +29,15 @@ int quesync::client::voice::rt_callback(void *outputBuffer, void *inputBuffer, u
 quesync::client::voice::manager::manager(std::shared_ptr<quesync::client::client> client,
                                          const char *server_ip)
     : _client(client),
-      _socket(socket_manager::io_context,
+      _io_work(asio::make_work_guard(_io_context)),
+      _socket(_io_context,
               udp::endpoint(udp::v4(), 0)),  // Create an IPv4 UDP socket with a random port
+      _activation_timer(_io_context),
+      _stats_timer(_io_context),
       _aes_key(nullptr),
       _hmac_key(nullptr),
+      _aead(nullptr),
+      _stream_id(0),
       _enabled(false),
       _stop_threads(false),
       _input_device_id(_rt_audio.getDefaultInputDevice()),
@@ -39,17 +45,19 @@ quesync::client::voice::manager::manager(std::shared_ptr<quesync::client::client
     // Get the endpoint of the server using the given server IP and default voice chat port
     socket_manager::get_endpoint(server_ip, VOICE_CHAT_PORT, _endpoint);
 
-    // Create the thread of activating and deactivating voice
-    _activation_thread = std::thread(&manager::voice_activation_thread, this);
+    // Run a background thread that handles the voice socket and timers
+    _io_thread = std::thread([this]() { _io_context.run(); });
 }
 
 void quesync::client::voice::manager::destroy() {
     // Signal all voice threads to stop
     _stop_threads = true;
 
-    // If the activation thread is still alive, join it
-    if (_activation_thread.joinable()) {
-        _activation_thread.join();
+    // Stop the I/O and wait for it's thread
+    _io_work.reset();
+    _io_context.stop();
+    if (_io_thread.joinable()) {
+        _io_thread.join();
     }
 
     // If the socket is open, close it
@@ -186,16 +194,21 @@ void quesync::client::voice::manager::init() {
     _output = std::make_shared<output>(shared_from_this());
 }
 
-void quesync::client::voice::manager::enable(std::string session_id, std::string channel_id,
+void quesync::client::voice::manager::enable(std::string session_id, uint32_t stream_id,
+                                             std::string channel_id,
                                              std::shared_ptr<unsigned char> aes_key,
                                              std::shared_ptr<unsigned char> hmac_key,
+                                             std::shared_ptr<utils::crypto::aead> aead,
                                              std::string otp) {
-    // Flush socket buffer
-    size_t available = _socket.available();
-    if (available) {
-        _socket.receive_from(
-            asio::buffer(std::shared_ptr<char>(new char[available]).get(), available), endpoint());
-    }
+    // Flush socket buffer from the I/O thread, so it doesn't race the pending receive
+    asio::post(_io_context, [this] {
+        size_t available = _socket.available();
+        if (available) {
+            _socket.receive_from(
+                asio::buffer(std::shared_ptr<char>(new char[available]).get(), available),
+                endpoint());
+        }
+    });
 
     // If not enabled, send the OTP packet to the server to authenticate
     if (!_enabled) {
@@ -203,9 +216,11 @@ void quesync::client::voice::manager::enable(std::string session_id, std::string
     }
 
     _session_id = session_id;
+    _stream_id = stream_id;
     _channel_id = channel_id;
     _aes_key = aes_key;
     _hmac_key = hmac_key;
+    _aead = aead;
 
     // Start the stream
     _rt_audio.startStream();
@@ -214,6 +229,12 @@ void quesync::client::voice::manager::enable(std::string session_id, std::string
     _enabled = true;
     _input->enable();
     _output->enable();
+
+    // Start the statistics events
+    asio::post(_io_context, [this] {
+        _stats_timer.expires_after(std::chrono::milliseconds(VOICE_STATS_INTERVAL_MS));
+        schedule_stats();
+    });
 }
 
 void quesync::client::voice::manager::disable() {
@@ -228,6 +249,15 @@ void quesync::client::voice::manager::disable() {
             _rt_audio.stopStream();
         } catch (...) {
         }
+
+        // Stop the statistics events
+        asio::post(_io_context, [this] { _stats_timer.cancel(); });
+
+        clear_group_key();
+
+        // Forget the voice streams of the call
+        std::unique_lock lk(_stream_users_mutex);
+        _stream_users.clear();
     }
 }
 
@@ -245,6 +275,21 @@ void quesync::client::voice::manager::set_state(bool mute, bool deafen) {
     }
 }
 
+void quesync::client::voice::manager::set_user_gain(std::string user_id, float gain) {
+    _output->set_user_gain(user_id, gain);
+}
+
+void quesync::client::voice::manager::set_voice_detection(bool enabled) {
+    _input->set_voice_detection(enabled);
+}
+
+float quesync::client::voice::manager::loss() { return _output->loss(); }
+
+void quesync::client::voice::manager::handle_report(const packets::voice_report_packet &report) {
+    // The round trip of the voice is our trip to the server and the receiver's trip from it
+    _input->handle_report(report, _output->rtt());
+}
+
 void quesync::client::voice::manager::init_stream() {
     unsigned int frame_size = FRAME_SIZE;
 
@@ -281,63 +326,98 @@ void quesync::client::voice::manager::init_stream() {
     }
 }
 
-void quesync::client::voice::manager::voice_activation_thread() {
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+void quesync::client::voice::manager::expire_voice_activity() {
+    std::unordered_map<std::string, bool> changed_voice_activity;
+    uint64_t current = get_ms(), deadline = 0;
 
-        // If all threads needs to be stopped
-        if (_stop_threads) {
-            break;
-        }
+    std::unique_lock lk(_activation_mutex);
+
+    // Deactivate the users whose deadline passed without a new activation
+    while (!_activation_deadlines.empty() && _activation_deadlines.begin()->first <= current) {
+        std::string user_id = std::move(_activation_deadlines.begin()->second);
+        _activation_deadlines.erase(_activation_deadlines.begin());
 
-        // If the stream isn't running, skip this iteration
-        if (!_enabled) {
-            continue;
+        activation &user = _voice_activation[user_id];
+        deadline = user.last_activated + DEACTIVIATION_TIMEOUT_MS;
+        if (deadline > current) {
+            _activation_deadlines.emplace(deadline, user_id);
+        } else {
+            user.activated = false;
+            _changed_voice_activity[user_id] = false;
         }
+    }
 
-        std::unique_lock lk(_activation_mutex);
-        uint64_t current = get_ms();
+    // Wait for the next deadline
+    if (!_activation_deadlines.empty()) {
+        _activation_timer.expires_after(
+            std::chrono::milliseconds(_activation_deadlines.begin()->first - current));
+        _activation_timer.async_wait([this](std::error_code ec) {
+            if (!ec) {
+                expire_voice_activity();
+            }
+        });
+    }
 
-        // For each user in the voice activation map
-        for (auto &user : _voice_activation) {
-            // If the user hasn't activated in the timeout
-            if (user.second.activated &&
-                current - user.second.last_activated >= DEACTIVIATION_TIMEOUT_MS) {
-                user.second.activated = false;
+    changed_voice_activity.swap(_changed_voice_activity);
+    lk.unlock();
 
-                _changed_voice_activity[user.first] = false;
-            }
+    // If user's activity has changed, call the voice activity event
+    if (changed_voice_activity.size()) {
+        try {
+            _client->communicator()->event_handler().call_event(std::static_pointer_cast<event>(
+                std::make_shared<events::voice_activity_event>(changed_voice_activity)));
+        } catch (...) {
         }
+    }
+}
 
-        // If user's activity has changed, call the voice activity event
-        if (_changed_voice_activity.size()) {
-            try {
-                _client->communicator()->event_handler().call_event(std::static_pointer_cast<event>(
-                    std::make_shared<events::voice_activity_event>(_changed_voice_activity)));
-            } catch (...) {
-            }
+void quesync::client::voice::manager::schedule_stats() {
+    _stats_timer.async_wait([this](std::error_code ec) {
+        if (ec || !_enabled) {
+            return;
         }
 
-        // Clear the changed voice activity
-        _changed_voice_activity.clear();
+        call_stats_event();
+
+        _stats_timer.expires_at(_stats_timer.expiry() +
+                                std::chrono::milliseconds(VOICE_STATS_INTERVAL_MS));
+        schedule_stats();
+    });
+}
+
+void quesync::client::voice::manager::call_stats_event() {
+    std::vector<quesync::voice::stream_stats> streams = _output->stats();
+    quesync::voice::stream_stats sent = _input->stats();
+
+    // Add the user's stream to the received streams
+    sent.stream_id = _stream_id;
+    sent.user_id = user_id();
+    streams.insert(streams.begin(), sent);
+
+    try {
+        _client->communicator()->event_handler().call_event(
+            std::static_pointer_cast<event>(std::make_shared<events::voice_stats_event>(
+                streams, _output->rtt(), _input->overruns(), _output->underruns())));
+    } catch (...) {
     }
 }
 
 void quesync::client::voice::manager::activate_voice(std::string user_id) {
-    std::unique_lock lk(_activation_mutex);
+    uint64_t current = get_ms();
 
-    // If the user already exists
-    if (_voice_activation.count(user_id)) {
-        // If not activated, active
-        if (!_voice_activation[user_id].activated) {
-            _voice_activation[user_id] = activation{true, get_ms()};
-            _changed_voice_activity[user_id] = true;
-        } else {
-            _voice_activation[user_id].last_activated = get_ms();
-        }
-    } else {
-        _voice_activation[user_id] = activation{true, get_ms()};
+    std::lock_guard lk(_activation_mutex);
+
+    activation &user = _voice_activation[user_id];
+    user.last_activated = current;
+
+    // If not activated, activate and queue it's deadline
+    if (!user.activated) {
+        user.activated = true;
         _changed_voice_activity[user_id] = true;
+        _activation_deadlines.emplace(current + DEACTIVIATION_TIMEOUT_MS, user_id);
+
+        // Call the event and reschedule the expiry from the I/O thread
+        asio::post(_io_context, [this] { expire_voice_activity(); });
     }
 }
 
@@ -358,12 +438,41 @@ uint64_t quesync::client::voice::manager::get_ms() {
 
 std::atomic<bool> &quesync::client::voice::manager::stop_threads() { return _stop_threads; }
 
+asio::io_context &quesync::client::voice::manager::io_context() { return _io_context; }
+
 bool quesync::client::voice::manager::enabled() { return _enabled; }
 
 std::shared_ptr<unsigned char> quesync::client::voice::manager::aes_key() { return _aes_key; }
 
 std::shared_ptr<unsigned char> quesync::client::voice::manager::hmac_key() { return _hmac_key; }
 
+std::shared_ptr<quesync::utils::crypto::aead> quesync::client::voice::manager::aead() {
+    return _aead;
+}
+
+void quesync::client::voice::manager::set_group_key(std::string key, uint32_t epoch,
+                                                    uint32_t nonce_prefix) {
+    std::shared_ptr<const group_key> current = std::atomic_load(&_group);
+
+    // Recreating the context of the same key would reuse it's nonces
+    if (current && current->epoch == epoch && current->nonce_prefix == nonce_prefix) {
+        return;
+    }
+
+    std::atomic_store(&_group, std::shared_ptr<const group_key>(std::make_shared<group_key>(
+                                   group_key{epoch, nonce_prefix,
+                                             std::make_shared<utils::crypto::aead>(
+                                                 (const unsigned char *)key.data(), nonce_prefix)})));
+}
+
+void quesync::client::voice::manager::clear_group_key() {
+    std::atomic_store(&_group, std::shared_ptr<const group_key>());
+}
+
+std::shared_ptr<const quesync::client::voice::group_key> quesync::client::voice::manager::group() {
+    return std::atomic_load(&_group);
+}
+
 bool quesync::client::voice::manager::muted() { return _input->muted(); }
 
 bool quesync::client::voice::manager::deafen() { return _output->deafen(); }
@@ -372,6 +481,25 @@ std::string quesync::client::voice::manager::user_id() { return _client->auth()-
 
 std::string quesync::client::voice::manager::session_id() { return _session_id; }
 
+uint32_t quesync::client::voice::manager::stream_id() { return _stream_id; }
+
+void quesync::client::voice::manager::set_stream_user(uint32_t stream_id, std::string user_id) {
+    std::unique_lock lk(_stream_users_mutex);
+
+    _stream_users[stream_id] = user_id;
+}
+
+std::string quesync::client::voice::manager::stream_user(uint32_t stream_id) {
+    std::unique_lock lk(_stream_users_mutex);
+
+    auto stream_user = _stream_users.find(stream_id);
+    if (stream_user == _stream_users.end()) {
+        return "";
+    }
+
+    return stream_user->second;
+}
+
 std::string quesync::client::voice::manager::channel_id() { return _channel_id; }
 
 udp::socket &quesync::client::voice::manager::socket() { return _socket; }
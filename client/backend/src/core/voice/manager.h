@@ -1,25 +1,25 @@
 #pragma once
 #include <RtAudio.h>
 #include <atomic>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <unordered_map>
 
+#include "../../../shared/packets/voice_report_packet.h"
+#include "../../../shared/utils/crypto/aead.h"
 #include "../socket_manager.h"
+#include "frame.h"
 #include "input.h"
 #include "output.h"
 #include "sound_device.h"
 
 #define VOICE_CHAT_PORT 61111
 
-#define RECORD_FREQUENCY 48000
-#define RECORD_CHANNELS 1
-#define PLAYBACK_CHANNELS 2
-#define FRAME_SIZE 480
-
 #define DEACTIVIATION_TIMEOUT_MS 250
+#define VOICE_STATS_INTERVAL_MS 1000
 
 namespace quesync {
 namespace client {
@@ -34,6 +34,17 @@ struct activation {
     uint64_t last_activated;
 };
 
+struct group_key {
+    /// The epoch of the key.
+    uint32_t epoch;
+
+    /// The nonce prefix the user must encrypt it's voice with.
+    uint32_t nonce_prefix;
+
+    /// The AES256-GCM context of the key.
+    std::shared_ptr<utils::crypto::aead> aead;
+};
+
 class manager : public std::enable_shared_from_this<manager> {
    public:
     /**
@@ -86,14 +97,16 @@ class manager : public std::enable_shared_from_this<manager> {
      * Enables the voice manager and starts the voice stream.
      *
      * @param session_id The voice session id.
+     * @param stream_id The id of the user's voice stream.
      * @param channel_id The voice channel id.
      * @param aes_key A buffer containing the AES key for the voice stream.
      * @param hmac_key A buffer containing the HMAC key for the voice stream.
+     * @param aead The AES256-GCM context of the voice stream, null to use AES256-CBC with HMAC.
      * @param otp The one-time password for the voice stream.
      */
-    void enable(std::string session_id, std::string channel_id,
+    void enable(std::string session_id, uint32_t stream_id, std::string channel_id,
                 std::shared_ptr<unsigned char> aes_key, std::shared_ptr<unsigned char> hmac_key,
-                std::string otp);
+                std::shared_ptr<utils::crypto::aead> aead, std::string otp);
 
     /**
      * Disables the voice manager and stops the voice stream.
@@ -129,6 +142,36 @@ class manager : public std::enable_shared_from_this<manager> {
      */
     bool deafen();
 
+    /**
+     * Sets the gain of a user's voice.
+     *
+     * @param user_id The id of the user.
+     * @param gain The linear gain of the user's voice, 1 keeps the volume as is.
+     */
+    void set_user_gain(std::string user_id, float gain);
+
+    /**
+     * Sets the voice detection mode of the input.
+     *
+     * @param enabled Should the transmission be gated by voice detection instead of a dB
+     *                threshold.
+     */
+    void set_voice_detection(bool enabled);
+
+    /**
+     * Get the measured loss rate of the voice stream.
+     *
+     * @return The fraction of the frames that were lost.
+     */
+    float loss();
+
+    /**
+     * Handles a report of a receiver on the user's voice stream.
+     *
+     * @param report The report of the receiver.
+     */
+    void handle_report(const packets::voice_report_packet &report);
+
     /**
      * Set the user's voice as active.
      *
@@ -150,6 +193,34 @@ class manager : public std::enable_shared_from_this<manager> {
      */
     std::shared_ptr<unsigned char> hmac_key();
 
+    /**
+     * Gets the voice stream AES256-GCM context.
+     *
+     * @return The AES256-GCM context, null if the stream uses AES256-CBC with HMAC.
+     */
+    std::shared_ptr<utils::crypto::aead> aead();
+
+    /**
+     * Sets the group key of the call, the voice is encrypted with it instead of the stream keys.
+     *
+     * @param key The group key.
+     * @param epoch The epoch of the group key.
+     * @param nonce_prefix The nonce prefix assigned to the user.
+     */
+    void set_group_key(std::string key, uint32_t epoch, uint32_t nonce_prefix);
+
+    /**
+     * Removes the group key of the call.
+     */
+    void clear_group_key();
+
+    /**
+     * Gets the group key of the call.
+     *
+     * @return The group key, null if the call doesn't use a group key.
+     */
+    std::shared_ptr<const group_key> group();
+
     /**
      * Gets the user id.
      *
@@ -164,6 +235,29 @@ class manager : public std::enable_shared_from_this<manager> {
      */
     std::string session_id();
 
+    /**
+     * Gets the id of the user's voice stream.
+     *
+     * @return The voice stream id.
+     */
+    uint32_t stream_id();
+
+    /**
+     * Sets the user that owns a voice stream.
+     *
+     * @param stream_id The id of the voice stream.
+     * @param user_id The id of the user.
+     */
+    void set_stream_user(uint32_t stream_id, std::string user_id);
+
+    /**
+     * Gets the user that owns a voice stream.
+     *
+     * @param stream_id The id of the voice stream.
+     * @return The id of the user, empty if the stream is unknown.
+     */
+    std::string stream_user(uint32_t stream_id);
+
     /**
      * Gets the voice channel id.
      *
@@ -171,6 +265,14 @@ class manager : public std::enable_shared_from_this<manager> {
      */
     std::string channel_id();
 
+    /**
+     * Gets the I/O context of the voice stream, the socket and the timers of the voice are
+     * handled by it.
+     *
+     * @return A reference to the voice I/O context.
+     */
+    asio::io_context &io_context();
+
     /**
      * Gets the voice stream socket.
      *
@@ -215,12 +317,30 @@ class manager : public std::enable_shared_from_this<manager> {
     /// The HMAC key buffer.
     std::shared_ptr<unsigned char> _hmac_key;
 
+    /// The AES256-GCM context.
+    std::shared_ptr<utils::crypto::aead> _aead;
+
+    /// The group key of the call, must be accessed with std::atomic_load.
+    std::shared_ptr<const group_key> _group;
+
     /// The session id.
     std::string _session_id;
 
+    /// The id of the user's voice stream.
+    std::atomic<uint32_t> _stream_id;
+
+    /// A map of the owner user of each voice stream in the call.
+    std::unordered_map<uint32_t, std::string> _stream_users;
+    std::mutex _stream_users_mutex;
+
     /// The channel id.
     std::string _channel_id;
 
+    /// The I/O context of the voice socket and timers, run by the I/O thread.
+    asio::io_context _io_context;
+    asio::executor_work_guard<asio::io_context::executor_type> _io_work;
+    std::thread _io_thread;
+
     /// The voice socket.
     udp::socket _socket;
     udp::endpoint _endpoint;
@@ -230,7 +350,15 @@ class manager : public std::enable_shared_from_this<manager> {
     std::unordered_map<std::string, bool> _changed_voice_activity;
     std::mutex _activation_mutex;
 
-    std::thread _activation_thread;
+    /// The time each active user's voice may expire at, ordered by the time. An expired user is
+    /// checked against it's last activation and queued again if it was activated since.
+    std::multimap<uint64_t, std::string> _activation_deadlines;
+
+    /// The timer of the first activation deadline.
+    asio::steady_timer _activation_timer;
+
+    /// The timer of the statistics event.
+    asio::steady_timer _stats_timer;
 
     /// Should the threads stop.
     std::atomic<bool> _stop_threads;
@@ -241,11 +369,14 @@ class manager : public std::enable_shared_from_this<manager> {
     unsigned int _input_device_id;
     unsigned int _output_device_id;
 
-    bool _enabled;
+    /// Is the voice enabled.
+    std::atomic<bool> _enabled;
 
     void init_stream();
 
-    void voice_activation_thread();
+    void expire_voice_activity();
+    void schedule_stats();
+    void call_stats_event();
 
     void send_otp_packet(std::string otp);
 
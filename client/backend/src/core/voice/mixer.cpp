@@ -0,0 +1,142 @@
+#include "mixer.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "dsp.h"
+
+#ifdef DSP_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+void add_scalar(int16_t *mix, const int16_t *pcm, int16_t gain, unsigned int i,
+                unsigned int samples) {
+    for (; i < samples; i++) {
+        mix[i] = (int16_t)std::clamp<int32_t>(
+            mix[i] + std::clamp<int32_t>((pcm[i] * gain) >> MIXER_GAIN_SHIFT,
+                                         std::numeric_limits<int16_t>::min(),
+                                         std::numeric_limits<int16_t>::max()),
+            std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
+    }
+}
+
+#ifdef DSP_X86
+DSP_AVX2 void add_avx2(int16_t *mix, const int16_t *pcm, int16_t gain, unsigned int samples) {
+    __m256i gain_vec = _mm256_set1_epi16(gain);
+    unsigned int i = 0;
+
+    for (; i + 16 <= samples; i += 16) {
+        __m256i samples_vec = _mm256_loadu_si256((const __m256i *)(pcm + i));
+
+        // Multiply into 32-bit products, scale them back and pack with saturation
+        __m256i lo = _mm256_mullo_epi16(samples_vec, gain_vec);
+        __m256i hi = _mm256_mulhi_epi16(samples_vec, gain_vec);
+        __m256i scaled = _mm256_packs_epi32(
+            _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), MIXER_GAIN_SHIFT),
+            _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), MIXER_GAIN_SHIFT));
+
+        _mm256_storeu_si256(
+            (__m256i *)(mix + i),
+            _mm256_adds_epi16(_mm256_loadu_si256((const __m256i *)(mix + i)), scaled));
+    }
+
+    add_scalar(mix, pcm, gain, i, samples);
+}
+
+void add_sse2(int16_t *mix, const int16_t *pcm, int16_t gain, unsigned int samples) {
+    __m128i gain_vec = _mm_set1_epi16(gain);
+    unsigned int i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128i samples_vec = _mm_loadu_si128((const __m128i *)(pcm + i));
+
+        // Multiply into 32-bit products, scale them back and pack with saturation
+        __m128i lo = _mm_mullo_epi16(samples_vec, gain_vec);
+        __m128i hi = _mm_mulhi_epi16(samples_vec, gain_vec);
+        __m128i scaled =
+            _mm_packs_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), MIXER_GAIN_SHIFT),
+                            _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), MIXER_GAIN_SHIFT));
+
+        _mm_storeu_si128((__m128i *)(mix + i),
+                         _mm_adds_epi16(_mm_loadu_si128((const __m128i *)(mix + i)), scaled));
+    }
+
+    add_scalar(mix, pcm, gain, i, samples);
+}
+#elif defined(__ARM_NEON)
+void add_neon(int16_t *mix, const int16_t *pcm, int16_t gain, unsigned int samples) {
+    int16x4_t gain_vec = vdup_n_s16(gain);
+    unsigned int i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t samples_vec = vld1q_s16(pcm + i);
+
+        // Multiply into 32-bit products and narrow them back with saturation
+        int16x8_t scaled =
+            vcombine_s16(vqshrn_n_s32(vmull_s16(vget_low_s16(samples_vec), gain_vec),
+                                      MIXER_GAIN_SHIFT),
+                         vqshrn_n_s32(vmull_s16(vget_high_s16(samples_vec), gain_vec),
+                                      MIXER_GAIN_SHIFT));
+
+        vst1q_s16(mix + i, vqaddq_s16(vld1q_s16(mix + i), scaled));
+    }
+
+    add_scalar(mix, pcm, gain, i, samples);
+}
+#endif
+};  // namespace
+
+int16_t quesync::client::voice::mixer::fixed_gain(float gain) {
+    return (int16_t)std::clamp<float>(gain * MIXER_GAIN_UNITY + 0.5f, 0,
+                                      std::numeric_limits<int16_t>::max());
+}
+
+void quesync::client::voice::mixer::add(int16_t *mix, const int16_t *pcm, int16_t gain,
+                                        unsigned int samples) {
+#ifdef DSP_X86
+    if (dsp::avx2()) {
+        add_avx2(mix, pcm, gain, samples);
+    } else {
+        add_sse2(mix, pcm, gain, samples);
+    }
+#elif defined(__ARM_NEON)
+    add_neon(mix, pcm, gain, samples);
+#else
+    add_scalar(mix, pcm, gain, 0, samples);
+#endif
+}
+
+void quesync::client::voice::mixer::upmix(int16_t *output, const int16_t *mix,
+                                          unsigned int samples, unsigned int channels) {
+    unsigned int i = 0;
+
+    if (channels == 2) {
+#ifdef DSP_X86
+        // Duplicate each sample to both channels
+        for (; i + 8 <= samples; i += 8) {
+            __m128i mix_vec = _mm_loadu_si128((const __m128i *)(mix + i));
+
+            _mm_storeu_si128((__m128i *)(output + i * 2), _mm_unpacklo_epi16(mix_vec, mix_vec));
+            _mm_storeu_si128((__m128i *)(output + i * 2 + 8),
+                             _mm_unpackhi_epi16(mix_vec, mix_vec));
+        }
+#elif defined(__ARM_NEON)
+        // Duplicate each sample to both channels
+        for (; i + 8 <= samples; i += 8) {
+            int16x8_t mix_vec = vld1q_s16(mix + i);
+
+            vst2q_s16(output + i * 2, int16x8x2_t{{mix_vec, mix_vec}});
+        }
+#endif
+    }
+
+    // Copy the rest of the samples to all channels
+    for (; i < samples; i++) {
+        for (unsigned int channel = 0; channel < channels; channel++) {
+            output[i * channels + channel] = mix[i];
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#define MIXER_GAIN_SHIFT 12
+#define MIXER_GAIN_UNITY (1 << MIXER_GAIN_SHIFT)
+
+namespace quesync {
+namespace client {
+namespace voice {
+class mixer {
+   public:
+    /**
+     * Converts a linear gain to the fixed point gain of the mixer.
+     *
+     * @param gain The linear gain, 1 keeps the volume as is.
+     * @return The fixed point gain.
+     */
+    static int16_t fixed_gain(float gain);
+
+    /**
+     * Adds a frame to a mix with saturation.
+     *
+     * @param mix The mix buffer.
+     * @param pcm The frame to add to the mix.
+     * @param gain The fixed point gain of the frame.
+     * @param samples The amount of samples in the frame.
+     */
+    static void add(int16_t *mix, const int16_t *pcm, int16_t gain, unsigned int samples);
+
+    /**
+     * Copies a mono mix to an interleaved output buffer.
+     *
+     * @param output The interleaved output buffer.
+     * @param mix The mono mix.
+     * @param samples The amount of samples in the mix.
+     * @param channels The amount of channels of the output buffer.
+     */
+    static void upmix(int16_t *output, const int16_t *mix, unsigned int samples,
+                      unsigned int channels);
+};
+};  // namespace voice
+};  // namespace client
+};  // namespace quesync
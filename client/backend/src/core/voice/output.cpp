@@ -1,134 +1,350 @@
 #include "output.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <limits>
 #include <sole.hpp>
 
 #include "manager.h"
+#include "mixer.h"
 
-#include "../../../shared/packets/voice_participant_packet.h"
+#include "../../../shared/packets/voice_packet.h"
+#include "../../../shared/packets/voice_report_packet.h"
 #include "../../../shared/utils/encryption.h"
 
 quesync::client::voice::output::output(std::shared_ptr<manager> manager)
-    : _manager(manager), _enabled(false), _deafen(false) {
-    int opus_error = 0;
-
-    // Create the opus decoder for the voice
-    _opus_decoder = opus_decoder_create(RECORD_FREQUENCY, RECORD_CHANNELS, &opus_error);
-    if (opus_error != OPUS_OK) {
-        std::cout << "An error occurred in initializing Opus Decoder! Exiting.." << std::endl;
-        exit(EXIT_FAILURE);
-    }
-
-    // Create the thread of the output
-    _thread = std::thread(&output::output_thread, this);
+    : _manager(manager),
+      _mixed_streams(std::make_shared<const std::vector<std::shared_ptr<jitter_buffer>>>()),
+      _underruns(0),
+      _rtt(0),
+      _last_report(0),
+      _receiving(false),
+      _enabled(false),
+      _deafen(false) {
+    // Create the playout thread, the voice is received by the I/O thread of the manager
+    _playout_thread = std::thread(&output::playout_thread, this);
 }
 
 quesync::client::voice::output::~output() {
-    // If the input thread is still alive, join it
-    if (_thread.joinable()) {
-        _thread.join();
+    // Wake the playout thread up, the lock makes sure it's waiting or will see the stop flag
+    {
+        std::lock_guard lk(_playout_mutex);
     }
+    _playout_cv.notify_one();
 
-    // Destory opus decoder
-    opus_decoder_destroy(_opus_decoder);
+    // If the playout thread is still alive, join it
+    if (_playout_thread.joinable()) {
+        _playout_thread.join();
+    }
 }
 
 void quesync::client::voice::output::callback_handler(void *output_buffer) {
-    std::unique_lock lk(_data_mutex);
+    pcm_frame mix;
 
-    // If empty, clean output buffer
-    if (_output_data.empty()) {
+    // Take the next mixed frame, if the playout thread fell behind play silence
+    if (!_output_data.pop(mix)) {
         memset(output_buffer, 0, FRAME_SIZE * PLAYBACK_CHANNELS * sizeof(int16_t));
-        return;
+
+        if (_enabled) {
+            _underruns++;
+        }
+    } else {
+        // Copy the mix to all the channels of the output buffer
+        mixer::upmix((int16_t *)output_buffer, mix.data(), FRAME_SIZE, PLAYBACK_CHANNELS);
+    }
+
+    // Notify the playout thread without taking it's lock
+    _playout_cv.notify_one();
+}
+
+uint64_t quesync::client::voice::output::underruns() { return _underruns; }
+
+std::vector<quesync::voice::stream_stats> quesync::client::voice::output::stats() {
+    std::vector<quesync::voice::stream_stats> streams;
+
+    std::lock_guard lk(_streams_mutex);
+
+    for (auto &stream : _streams) {
+        streams.push_back(stream.second->stats());
+        streams.back().stream_id = stream.first;
+        streams.back().user_id = _manager->stream_user(stream.first);
     }
 
-    // Pop the last output data
-    std::shared_ptr<int16_t> buf = _output_data.front();
-    _output_data.pop();
+    return streams;
+}
+
+void quesync::client::voice::output::playout_thread() {
+    int16_t pcm[FRAME_SIZE];
+    pcm_frame mix;
+
+    std::shared_ptr<const std::vector<std::shared_ptr<jitter_buffer>>> streams;
+
+    while (true) {
+        // Wait until the audio callback takes a frame, the callback doesn't take the lock so the
+        // wait is bounded to recover from a notification that was missed
+        std::unique_lock lk(_playout_mutex);
+        _playout_cv.wait_for(lk, std::chrono::milliseconds(OUTPUT_WAIT_MS), [this] {
+            return _manager->stop_threads() ||
+                   (_enabled && _output_data.size() < OUTPUT_PLAYOUT_FRAMES);
+        });
+        lk.unlock();
+        if (_manager->stop_threads()) {
+            break;
+        }
+
+        // Keep a few mixed frames ahead of the audio callback
+        while (_enabled && _output_data.size() < OUTPUT_PLAYOUT_FRAMES) {
+            mix.fill(0);
 
-    // Unlock the mutex
-    lk.unlock();
+            // Mix the next frame of each stream
+            streams = std::atomic_load(&_mixed_streams);
+            for (auto &stream : *streams) {
+                if (stream->pop(pcm)) {
+                    mixer::add(mix.data(), pcm, stream->gain(), FRAME_SIZE);
+                }
+            }
 
-    // Copy the buffer to the output buffer + Convert from MONO to STEREO
-    for (int i = 0; i < FRAME_SIZE; i++) {
-        *((int16_t *)output_buffer + i * PLAYBACK_CHANNELS) =
-            *((int16_t *)output_buffer + i * PLAYBACK_CHANNELS + 1) = buf.get()[i];
+            _output_data.push(mix);
+        }
     }
 }
 
 void quesync::client::voice::output::enable() {
-    std::queue<std::shared_ptr<int16_t>> q;
+    {
+        std::lock_guard lk(_streams_mutex);
 
-    // Swap with a clean queue to clean it
-    std::swap(q, _output_data);
+        // Clean the streams of the previous call
+        _streams.clear();
+        publish_streams();
+    }
+
+    {
+        std::lock_guard lk(_playout_mutex);
+        _enabled = true;
+    }
+    _playout_cv.notify_one();
 
-    _enabled = true;
+    // Start receiving, unless the receive of the previous call is still pending
+    asio::post(_manager->io_context(), [this] {
+        if (!_receiving) {
+            _receiving = true;
+            receive();
+        }
+    });
 }
 
-void quesync::client::voice::output::output_thread() {
-    int decoded_size = 0, recv_bytes = 0;
-    char recv_buffer[RECV_BUFFER_SIZE] = {0};
+std::shared_ptr<quesync::client::voice::jitter_buffer> quesync::client::voice::output::get_stream(
+    uint32_t stream_id) {
+    std::shared_ptr<jitter_buffer> stream;
+    std::string user_id;
+    bool changed = false;
+
+    std::lock_guard lk(_streams_mutex);
+
+    // Remove streams that stopped sending
+    for (auto it = _streams.begin(); it != _streams.end();) {
+        if (it->first != stream_id && it->second->idle_frames() > MAX_STREAM_IDLE_FRAMES) {
+            it = _streams.erase(it);
+            changed = true;
+        } else {
+            it++;
+        }
+    }
+
+    // Create the jitter buffer of a new stream with the gain of it's user
+    stream = _streams[stream_id];
+    if (!stream) {
+        stream = _streams[stream_id] = std::make_shared<jitter_buffer>();
+        changed = true;
+
+        user_id = _manager->stream_user(stream_id);
+        if (_user_gains.count(user_id)) {
+            stream->set_gain(mixer::fixed_gain(_user_gains[user_id]));
+        }
+    }
 
-    int16_t pcm[FRAME_SIZE] = {0};
+    if (changed) {
+        publish_streams();
+    }
 
-    udp::endpoint sender_endpoint;
-    std::shared_ptr<packets::voice_participant_packet> voice_packet;
+    return stream;
+}
 
-    while (true) {
-        std::shared_ptr<int16_t> buffer(new int16_t[FRAME_SIZE]);
+void quesync::client::voice::output::publish_streams() {
+    std::shared_ptr<std::vector<std::shared_ptr<jitter_buffer>>> streams =
+        std::make_shared<std::vector<std::shared_ptr<jitter_buffer>>>();
 
-        // If all threads needs to be stopped
-        if (_manager->stop_threads()) {
-            break;
+    for (auto &stream : _streams) {
+        streams->push_back(stream.second);
+    }
+
+    std::atomic_store(&_mixed_streams,
+                      std::shared_ptr<const std::vector<std::shared_ptr<jitter_buffer>>>(streams));
+}
+
+float quesync::client::voice::output::loss() {
+    std::shared_ptr<const std::vector<std::shared_ptr<jitter_buffer>>> streams =
+        std::atomic_load(&_mixed_streams);
+    float loss = 0;
+
+    for (auto &stream : *streams) {
+        loss = std::max(loss, stream->loss());
+    }
+
+    return loss;
+}
+
+uint32_t quesync::client::voice::output::rtt() { return _rtt; }
+
+void quesync::client::voice::output::send_reports() {
+    std::shared_ptr<utils::crypto::aead> aead = _manager->aead();
+    std::vector<packets::voice_report_packet> reports;
+    std::string report_encrypted;
+
+    {
+        std::lock_guard lk(_streams_mutex);
+
+        // Report the quality of each received stream to it's sender
+        for (auto &stream : _streams) {
+            reports.emplace_back(
+                stream.first, (uint8_t)std::lround(stream.second->loss() * 255),
+                (uint16_t)std::min<double>(stream.second->jitter(),
+                                           std::numeric_limits<uint16_t>::max()),
+                (uint16_t)std::min<uint32_t>(_rtt, std::numeric_limits<uint16_t>::max()),
+                (uint32_t)_manager->get_ms());
         }
+    }
 
-        // If disabled, skip
-        if (!_enabled) {
-            std::this_thread::sleep_for(std::chrono::microseconds(750));
-            continue;
+    for (auto &report : reports) {
+        // The reports are always encrypted with the stream keys, even if the call uses a group key
+        if (aead) {
+            report_encrypted = utils::encryption::encrypt_voice_packet(&report, aead.get());
+        } else {
+            report_encrypted = utils::encryption::encrypt_voice_packet(
+                &report, _manager->aes_key().get(), _manager->hmac_key().get());
         }
 
-        try {
-            // Receive from the server the encoded voice sample into the recv buffer
-            recv_bytes = (int)_manager->socket().receive_from(
-                asio::buffer(recv_buffer, RECV_BUFFER_SIZE), sender_endpoint);
-        } catch (...) {
-            break;
+        _manager->socket().send_to(
+            asio::buffer(report_encrypted.c_str(), report_encrypted.length()),
+            _manager->endpoint());
+    }
+}
+
+void quesync::client::voice::output::handle_report(const std::string &data) {
+    std::shared_ptr<utils::crypto::aead> aead = _manager->aead();
+    std::shared_ptr<packets::voice_report_packet> report;
+    uint32_t sample = 0, rtt = 0;
+
+    // Decode the report
+    if (aead) {
+        report = utils::encryption::decrypt_voice_packet<packets::voice_report_packet>(data,
+                                                                                      aead.get());
+    } else {
+        report = utils::encryption::decrypt_voice_packet<packets::voice_report_packet>(
+            data, _manager->aes_key().get(), _manager->hmac_key().get());
+    }
+    if (!report) {
+        return;
+    }
+
+    // A report on the user's stream is feedback for the encoder
+    if (report->stream_id() == _manager->stream_id()) {
+        _manager->handle_report(*report);
+        return;
+    }
+
+    // Otherwise it's the echo of one of our reports, measure the round trip time with it
+    sample = (uint32_t)_manager->get_ms() - report->timestamp();
+    rtt = _rtt;
+    _rtt = rtt ? (uint32_t)(rtt + ((float)sample - rtt) * RTT_SMOOTHING) : std::max(sample, 1u);
+}
+
+void quesync::client::voice::output::set_user_gain(std::string user_id, float gain) {
+    std::lock_guard lk(_streams_mutex);
+
+    _user_gains[user_id] = gain;
+
+    // Update the gain of the user's current streams
+    for (auto &stream : _streams) {
+        if (_manager->stream_user(stream.first) == user_id) {
+            stream.second->set_gain(mixer::fixed_gain(gain));
         }
+    }
+}
 
-        // If the sender is the server endpoint handle the voice sample
-        if (sender_endpoint == _manager->endpoint()) {
-            // Decode the voice packet
-            voice_packet =
-                utils::encryption::decrypt_voice_packet<packets::voice_participant_packet>(
-                    std::string(recv_buffer, recv_bytes), _manager->aes_key().get(),
-                    _manager->hmac_key().get());
-            if (!voice_packet) {
-                continue;
+void quesync::client::voice::output::receive() {
+    _manager->socket().async_receive_from(
+        asio::buffer(_recv_buffer, RECV_BUFFER_SIZE), _sender_endpoint,
+        [this](std::error_code ec, std::size_t bytes) {
+            // If disabled, stop receiving until the output is enabled again
+            if (!_enabled) {
+                _receiving = false;
+                return;
             }
 
-            // Activate the user's voice
-            _manager->activate_voice(voice_packet->user_id());
-
-            // If deafen, continue
-            if (_deafen) {
-                continue;
+            // If the sender is the server endpoint handle the voice sample
+            if (!ec && _sender_endpoint == _manager->endpoint()) {
+                handle_packet(bytes);
             }
 
-            // Decode the current sample from the client
-            decoded_size =
-                opus_decode(_opus_decoder, (const unsigned char *)voice_packet->voice_data(),
-                            voice_packet->voice_data_len(), (opus_int16 *)pcm, FRAME_SIZE, 0);
+            receive();
+        });
+}
+
+void quesync::client::voice::output::handle_packet(std::size_t bytes) {
+    std::string data(_recv_buffer, bytes);
+    std::shared_ptr<packets::voice_packet> voice_packet;
+    std::shared_ptr<jitter_buffer> stream;
+    std::string user_id;
+    std::shared_ptr<utils::crypto::aead> aead;
+    std::shared_ptr<const group_key> group;
 
-            // Copy the PCM to the buffer
-            memcpy(buffer.get(), pcm, FRAME_SIZE * sizeof(int16_t));
+    // Send the reports of the received streams periodically
+    if (_manager->get_ms() - _last_report >= REPORT_INTERVAL_MS) {
+        _last_report = _manager->get_ms();
 
-            // Push the output buffer to the output data queue
-            std::unique_lock lk(_data_mutex);
-            _output_data.push(buffer);
+        try {
+            send_reports();
+        } catch (...) {
         }
     }
+
+    // Decode the voice packet
+    group = _manager->group();
+    aead = _manager->aead();
+    if (group) {
+        voice_packet = utils::encryption::decrypt_group_voice_packet<packets::voice_packet>(
+            data, group->epoch, group->aead.get());
+    } else if (aead) {
+        voice_packet = utils::encryption::decrypt_voice_packet<packets::voice_packet>(data,
+                                                                                     aead.get());
+    } else {
+        voice_packet = utils::encryption::decrypt_voice_packet<packets::voice_packet>(
+            data, _manager->aes_key().get(), _manager->hmac_key().get());
+    }
+    if (!voice_packet) {
+        // If it's not a voice packet, it may be a report
+        handle_report(data);
+        return;
+    }
+
+    // Activate the voice of the user that owns the stream
+    user_id = _manager->stream_user(voice_packet->stream_id());
+    if (!user_id.empty()) {
+        _manager->activate_voice(user_id);
+    }
+
+    // If deafen, ignore the voice
+    if (_deafen) {
+        return;
+    }
+
+    // Get the jitter buffer of the stream, each stream is decoded by it's own decoder
+    stream = get_stream(voice_packet->stream_id());
+
+    // Queue the frame by it's sequence number
+    stream->push(*voice_packet);
 }
 
 void quesync::client::voice::output::disable() { _enabled = false; }
@@ -2,15 +2,31 @@
 #include <RtAudio.h>
 #include <opus.h>
 
+#include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../socket_manager.h"
+#include "frame.h"
+#include "jitter_buffer.h"
+#include "spsc_ring.h"
 
 #define RECV_BUFFER_SIZE 8192
 
+#define MAX_STREAM_IDLE_FRAMES 500
+
+#define REPORT_INTERVAL_MS 1000
+#define RTT_SMOOTHING 0.125f
+
+#define OUTPUT_RING_FRAMES 4
+#define OUTPUT_PLAYOUT_FRAMES 2
+#define OUTPUT_WAIT_MS 10
+
 namespace quesync {
 namespace client {
 namespace voice {
@@ -57,6 +73,28 @@ class output {
      */
     bool deafen();
 
+    /**
+     * Sets the gain of a user's voice.
+     *
+     * @param user_id The id of the user.
+     * @param gain The linear gain of the user's voice, 1 keeps the volume as is.
+     */
+    void set_user_gain(std::string user_id, float gain);
+
+    /**
+     * Get the loss rate of the worst received stream.
+     *
+     * @return The fraction of the frames that were lost.
+     */
+    float loss();
+
+    /**
+     * Get the smoothed round trip time to the server, measured by the echo of the reports.
+     *
+     * @return The round trip time in milliseconds.
+     */
+    uint32_t rtt();
+
     /**
      * Handles the callback from the audio framework.
      *
@@ -64,26 +102,71 @@ class output {
      */
     void callback_handler(void *output_buffer);
 
+    /**
+     * Get the amount of times the audio callback found no mixed frame to play.
+     *
+     * @return The amount of underruns.
+     */
+    uint64_t underruns();
+
+    /**
+     * Get the statistics of the received streams.
+     *
+     * @return The statistics of each received stream.
+     */
+    std::vector<quesync::voice::stream_stats> stats();
+
    private:
     /// A shared pointer to the voice manager object.
     std::shared_ptr<manager> _manager;
 
-    /// A queue of the output data buffers
-    std::queue<std::shared_ptr<int16_t>> _output_data;
-    std::mutex _data_mutex;
+    /// The jitter buffer of each remote stream by it's stream id.
+    std::unordered_map<uint32_t, std::shared_ptr<jitter_buffer>> _streams;
+    std::mutex _streams_mutex;
 
-    std::thread _thread;
+    /// The streams mixed by the playout thread. Replaced atomically when a stream is added or
+    /// removed, must be accessed with std::atomic_load.
+    std::shared_ptr<const std::vector<std::shared_ptr<jitter_buffer>>> _mixed_streams;
 
-    /// A pointer to the opus decoder.
-    OpusDecoder *_opus_decoder;
+    /// The smoothed round trip time to the server in milliseconds, 0 until it's measured.
+    std::atomic<uint32_t> _rtt;
+
+    /// The last time the reports of the received streams were sent.
+    uint64_t _last_report;
+
+    /// The linear gain of each user's voice.
+    std::unordered_map<std::string, float> _user_gains;
+
+    /// The buffer and the sender of the pending receive, used only by the I/O thread.
+    char _recv_buffer[RECV_BUFFER_SIZE];
+    udp::endpoint _sender_endpoint;
+
+    /// Is a receive pending on the voice socket, used only by the I/O thread.
+    bool _receiving;
+
+    /// The mixed frames, filled by the playout thread and drained by the audio callback.
+    spsc_ring<pcm_frame, OUTPUT_RING_FRAMES> _output_data;
+    std::mutex _playout_mutex;
+    std::condition_variable _playout_cv;
+
+    /// The amount of times the audio callback found the ring empty.
+    std::atomic<uint64_t> _underruns;
+
+    std::thread _playout_thread;
 
     /// Is the output enabled.
-    bool _enabled;
+    std::atomic<bool> _enabled;
 
     // Is the output muted.
-    bool _deafen;
-
-    void output_thread();
+    std::atomic<bool> _deafen;
+
+    void receive();
+    void handle_packet(std::size_t bytes);
+    void playout_thread();
+    std::shared_ptr<jitter_buffer> get_stream(uint32_t stream_id);
+    void publish_streams();
+    void send_reports();
+    void handle_report(const std::string &data);
 };
 };  // namespace voice
 };  // namespace client
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace quesync {
+namespace client {
+namespace voice {
+template <typename T, std::size_t N>
+class spsc_ring {
+    static_assert(N && !(N & (N - 1)), "The capacity of the ring must be a power of 2");
+
+   public:
+    /**
+     * Copies an item to the ring, may only be called by the producer thread.
+     *
+     * @param item The item to copy.
+     * @return True if the item was copied or false if the ring is full.
+     */
+    bool push(const T &item) {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+
+        if (head - _tail.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+
+        _items[head & (N - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * Copies the oldest item out of the ring, may only be called by the consumer thread.
+     *
+     * @param item The item to copy to.
+     * @return True if an item was copied or false if the ring is empty.
+     */
+    bool pop(T &item) {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = _items[tail & (N - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * Drops all the items in the ring, may only be called by the consumer thread.
+     */
+    void clear() { _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release); }
+
+    /**
+     * Get the amount of items in the ring.
+     *
+     * @return The amount of items in the ring.
+     */
+    std::size_t size() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+   private:
+    /// The preallocated items of the ring.
+    std::array<T, N> _items;
+
+    /// The total amount of items pushed, written only by the producer.
+    alignas(64) std::atomic<std::size_t> _head{0};
+
+    /// The total amount of items popped, written only by the consumer.
+    alignas(64) std::atomic<std::size_t> _tail{0};
+};
+};  // namespace voice
+};  // namespace client
+};  // namespace quesync
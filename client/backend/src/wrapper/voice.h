@@ -20,7 +20,9 @@ class voice : public Napi::ObjectWrap<voice>, public module<voice> {
              InstanceMethod("getInputDevices", &voice::get_input_devices),
              InstanceMethod("getOutputDevices", &voice::get_output_devices),
              InstanceMethod("setInputDevice", &voice::set_input_device),
-             InstanceMethod("setOutputDevice", &voice::set_output_device)});
+             InstanceMethod("setOutputDevice", &voice::set_output_device),
+             InstanceMethod("setUserGain", &voice::set_user_gain),
+             InstanceMethod("setVoiceDetection", &voice::set_voice_detection)});
     }
 
     voice(const Napi::CallbackInfo &info) : Napi::ObjectWrap<voice>(info), module(info) {}
@@ -28,11 +30,14 @@ class voice : public Napi::ObjectWrap<voice>, public module<voice> {
     Napi::Value call(const Napi::CallbackInfo &info) {
         std::string channel_id = info[0].As<Napi::String>();
 
-        return executer::create_executer(info.Env(), [this, channel_id]() {
+        // The group key mode is optional, per-stream keys are used by default
+        bool group_key = info.Length() > 1 && info[1].IsBoolean() && info[1].As<Napi::Boolean>();
+
+        return executer::create_executer(info.Env(), [this, channel_id, group_key]() {
             std::shared_ptr<call_details> call_details;
 
             // Call the channel and get the voice states
-            call_details = _client->core()->voice()->call(channel_id);
+            call_details = _client->core()->voice()->call(channel_id, group_key);
 
             return nlohmann::json{{"callDetails", *call_details}, {"channelId", channel_id}};
         });
@@ -117,6 +122,27 @@ class voice : public Napi::ObjectWrap<voice>, public module<voice> {
         });
     }
 
+    Napi::Value set_user_gain(const Napi::CallbackInfo &info) {
+        std::string user_id = info[0].As<Napi::String>();
+        float gain = info[1].As<Napi::Number>();
+
+        return executer::create_executer(info.Env(), [this, user_id, gain]() {
+            // Set the gain of the user's voice
+            _client->core()->voice()->set_user_gain(user_id, gain);
+            return nlohmann::json();
+        });
+    }
+
+    Napi::Value set_voice_detection(const Napi::CallbackInfo &info) {
+        bool enabled = info[0].As<Napi::Boolean>();
+
+        return executer::create_executer(info.Env(), [this, enabled]() {
+            // Set the voice detection mode
+            _client->core()->voice()->set_voice_detection(enabled);
+            return nlohmann::json();
+        });
+    }
+
     inline static Napi::FunctionReference constructor;
 };
 };  // namespace wrapper
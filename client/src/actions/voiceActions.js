@@ -1,10 +1,10 @@
-export function call(channelId) {
+export function call(channelId, groupKey = false) {
 	return (dispatch, getState) => {
 		const client = getState().client.client;
 
 		return dispatch({
 			type: "CALL",
-			payload: client.voice().call(channelId)
+			payload: client.voice().call(channelId, groupKey)
 		});
 	}
 }
@@ -23,6 +23,8 @@ const textForError = error => {
 			return "The download path is invalid";
 		case window.errors.profile_photo_too_big:
 			return "The size of the profile photo is too big";
+		case window.errors.server_busy:
+			return "The server is busy, please try again";
 		case window.errors.unknown_error:
 		default:
 			return "Unknown Error";
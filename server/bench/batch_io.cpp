@@ -0,0 +1,201 @@
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include "../../shared/bench/bench.h"
+#include "../src/voice_manager.h"
+
+#define DATAGRAM_SIZE 200
+#define RUN_MS 1000
+
+using namespace quesync;
+
+#ifdef __linux__
+/**
+ * Sends datagrams to an endpoint in batches until stopped.
+ *
+ * @param socket The socket to send from.
+ * @param endpoint The endpoint to send to.
+ * @param stop Should the sending stop.
+ */
+static void flood(udp::socket &socket, udp::endpoint endpoint, std::atomic<bool> &stop) {
+    char buf[DATAGRAM_SIZE] = {0};
+    iovec iovecs[VOICE_BATCH_SIZE];
+    mmsghdr msgs[VOICE_BATCH_SIZE];
+
+    for (int i = 0; i < VOICE_BATCH_SIZE; i++) {
+        iovecs[i] = iovec{buf, DATAGRAM_SIZE};
+
+        msgs[i] = mmsghdr{};
+        msgs[i].msg_hdr.msg_name = endpoint.data();
+        msgs[i].msg_hdr.msg_namelen = (socklen_t)endpoint.size();
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (!stop) {
+        sendmmsg(socket.native_handle(), msgs, VOICE_BATCH_SIZE, 0);
+    }
+}
+
+/**
+ * Receives datagrams with one asynchronous receive per datagram, as the asio I/O path does.
+ *
+ * @param io_context The I/O context of the socket.
+ * @param socket The socket to receive from.
+ * @return The amount of datagrams received per second.
+ */
+static double receive_per_packet(asio::io_context &io_context, udp::socket &socket) {
+    char buf[MAX_DATA_LEN];
+    udp::endpoint sender;
+    uint64_t received = 0;
+    std::function<void()> receive;
+
+    receive = [&] {
+        socket.async_receive_from(asio::buffer(buf, MAX_DATA_LEN), sender,
+                                  [&](std::error_code ec, std::size_t) {
+                                      if (!ec) {
+                                          received++;
+                                          receive();
+                                      }
+                                  });
+    };
+    receive();
+
+    io_context.restart();
+    io_context.run_for(std::chrono::milliseconds(RUN_MS));
+    socket.cancel();
+    io_context.run();
+
+    return received * 1000.0 / RUN_MS;
+}
+
+/**
+ * Receives datagrams with recvmmsg whenever the socket is readable, as the batched I/O path
+ * does.
+ *
+ * @param io_context The I/O context of the socket.
+ * @param socket The socket to receive from.
+ * @return The amount of datagrams received per second.
+ */
+static double receive_batched(asio::io_context &io_context, udp::socket &socket) {
+    std::unique_ptr<voice::batch> batch = std::make_unique<voice::batch>();
+    uint64_t received = 0;
+    std::function<void()> receive;
+
+    receive = [&] {
+        socket.async_wait(udp::socket::wait_read, [&](std::error_code ec) {
+            int res = 0;
+
+            if (ec) {
+                return;
+            }
+
+            do {
+                for (int i = 0; i < VOICE_BATCH_SIZE; i++) {
+                    batch->recv_iovecs[i] = iovec{batch->bufs[i], MAX_DATA_LEN};
+
+                    batch->recv_msgs[i] = mmsghdr{};
+                    batch->recv_msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+                    batch->recv_msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+                    batch->recv_msgs[i].msg_hdr.msg_iov = &batch->recv_iovecs[i];
+                    batch->recv_msgs[i].msg_hdr.msg_iovlen = 1;
+                }
+
+                res = recvmmsg(socket.native_handle(), batch->recv_msgs, VOICE_BATCH_SIZE,
+                               MSG_DONTWAIT, nullptr);
+                if (res > 0) {
+                    received += res;
+                }
+            } while (res == VOICE_BATCH_SIZE);
+
+            receive();
+        });
+    };
+    receive();
+
+    io_context.restart();
+    io_context.run_for(std::chrono::milliseconds(RUN_MS));
+    socket.cancel();
+    io_context.run();
+
+    return received * 1000.0 / RUN_MS;
+}
+
+/**
+ * Receives a flood of datagrams with one of the receive paths.
+ *
+ * @param receive The receive path.
+ * @return The amount of datagrams received per second.
+ */
+template <typename Receive>
+static double measure_receive(Receive receive) {
+    asio::io_context io_context;
+    udp::socket receiver(io_context, udp::endpoint(asio::ip::address_v4::loopback(), 0));
+    udp::socket sender(io_context, udp::endpoint(asio::ip::address_v4::loopback(), 0));
+    std::atomic<bool> stop(false);
+    double rate = 0;
+
+    std::thread flooder(flood, std::ref(sender), receiver.local_endpoint(), std::ref(stop));
+    rate = receive(io_context, receiver);
+    stop = true;
+    flooder.join();
+
+    return rate;
+}
+
+int main() {
+    asio::io_context io_context;
+    udp::socket socket(io_context, udp::endpoint(asio::ip::address_v4::loopback(), 0));
+    udp::socket sink(io_context, udp::endpoint(asio::ip::address_v4::loopback(), 0));
+    udp::endpoint sink_endpoint = sink.local_endpoint();
+    std::shared_ptr<std::string> datagram = std::make_shared<std::string>(DATAGRAM_SIZE, '\0');
+    std::unique_ptr<voice::batch> batch = std::make_unique<voice::batch>();
+
+    std::cout << "Voice datagrams per second on loopback\n";
+
+    bench::report("Receive, async_receive_from per packet", measure_receive(receive_per_packet),
+                  "packets/s");
+    bench::report("Receive, recvmmsg", measure_receive(receive_batched), "packets/s");
+
+    // Send the fan-out copies of a datagram with an asynchronous send each
+    double per_packet = bench::measure(VOICE_BATCH_SIZE * 10000, [&](std::size_t i) {
+        socket.async_send_to(asio::buffer(datagram->data(), datagram->length()), sink_endpoint,
+                             [datagram](std::error_code, std::size_t) {});
+
+        // Complete the sends of a whole batch at once
+        if (i % VOICE_BATCH_SIZE == VOICE_BATCH_SIZE - 1) {
+            io_context.restart();
+            io_context.run();
+        }
+
+        return 0;
+    });
+
+    // Send the fan-out copies in batches of sendmmsg
+    for (int i = 0; i < VOICE_BATCH_SIZE; i++) {
+        batch->send_iovecs[i] = iovec{(void *)datagram->data(), datagram->length()};
+
+        batch->send_msgs[i] = mmsghdr{};
+        batch->send_msgs[i].msg_hdr.msg_name = sink_endpoint.data();
+        batch->send_msgs[i].msg_hdr.msg_namelen = (socklen_t)sink_endpoint.size();
+        batch->send_msgs[i].msg_hdr.msg_iov = &batch->send_iovecs[i];
+        batch->send_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    double batched = bench::measure(10000, [&](std::size_t) {
+        return sendmmsg(socket.native_handle(), batch->send_msgs, VOICE_BATCH_SIZE, 0);
+    });
+
+    bench::report("Send, async_send_to per packet", 1e9 / per_packet, "packets/s");
+    bench::report("Send, sendmmsg", 1e9 * VOICE_BATCH_SIZE / batched, "packets/s");
+
+    return 0;
+}
+#else
+int main() {
+    std::cout << "The batched voice I/O path is only available on Linux\n";
+
+    return 0;
+}
+#endif
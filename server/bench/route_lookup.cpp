@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../shared/bench/bench.h"
+#include "../src/voice_manager.h"
+
+#define LOOKUPS_PER_SIZE 2000000
+#define SCANNED_ENDPOINTS_PER_SIZE 50000000
+
+using namespace quesync;
+
+/**
+ * Finds the route of an endpoint the same way the voice manager does on every voice packet.
+ *
+ * @param routes The shards of the routing table.
+ * @param endpoint The endpoint of the sender.
+ * @return The route of the endpoint, null if not found.
+ */
+static std::shared_ptr<const voice::route> find_route(
+    std::array<std::shared_ptr<const voice::routing_shard>, ROUTING_SHARDS> &routes,
+    const udp::endpoint &endpoint) {
+    std::shared_ptr<const voice::routing_shard> shard =
+        std::atomic_load(&routes[voice::endpoint_hash()(endpoint) % ROUTING_SHARDS]);
+
+    auto route = shard->routes.find(endpoint);
+    if (route == shard->routes.end()) {
+        return nullptr;
+    }
+
+    return route->second;
+}
+
+int main() {
+    std::mt19937 random(1);
+
+    std::cout << "Voice route lookup per packet\n";
+
+    for (std::size_t sessions : {10, 100, 1000, 10000, 50000}) {
+        std::array<std::shared_ptr<voice::routing_shard>, ROUTING_SHARDS> shards;
+        std::array<std::shared_ptr<const voice::routing_shard>, ROUTING_SHARDS> routes;
+        std::unordered_map<std::string, udp::endpoint> session_endpoints;
+        std::vector<udp::endpoint> endpoints;
+
+        for (auto &shard : shards) {
+            shard = std::make_shared<voice::routing_shard>();
+        }
+
+        // Give each session a random client address and port
+        for (std::size_t i = 0; i < sessions; i++) {
+            udp::endpoint endpoint(asio::ip::address_v4((uint32_t)random()),
+                                   (unsigned short)(1024 + random() % 60000));
+            std::shared_ptr<voice::route> route = std::make_shared<voice::route>();
+
+            route->session_id = std::to_string(i);
+            route->stream_id = (uint32_t)i + 1;
+
+            shards[voice::endpoint_hash()(endpoint) % ROUTING_SHARDS]->routes[endpoint] = route;
+            session_endpoints[route->session_id] = endpoint;
+            endpoints.push_back(endpoint);
+        }
+        for (std::size_t i = 0; i < ROUTING_SHARDS; i++) {
+            routes[i] = shards[i];
+        }
+
+        // Look up senders in a random order so the lookups don't share cache lines
+        std::shuffle(endpoints.begin(), endpoints.end(), random);
+
+        double hashed = bench::measure(LOOKUPS_PER_SIZE, [&](std::size_t i) {
+            return find_route(routes, endpoints[i % sessions])->stream_id;
+        });
+
+        // The linear scan the relay used before the routing table, limited so the large sizes
+        // finish in a reasonable time
+        double scanned =
+            bench::measure(std::max<std::size_t>(SCANNED_ENDPOINTS_PER_SIZE / sessions, 100),
+                           [&](std::size_t i) {
+                               const udp::endpoint &sender = endpoints[i % sessions];
+
+                               return std::find_if(session_endpoints.begin(),
+                                                   session_endpoints.end(),
+                                                   [&sender](const auto &p) {
+                                                       return p.second == sender;
+                                                   })
+                                   ->first.length();
+                           });
+
+        bench::report(std::to_string(sessions) + " sessions, routing table", hashed, "ns");
+        bench::report(std::to_string(sessions) + " sessions, linear scan", scanned, "ns");
+    }
+
+    return 0;
+}
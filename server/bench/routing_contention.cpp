@@ -0,0 +1,168 @@
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../../shared/bench/bench.h"
+#include "../src/voice_manager.h"
+
+#define SESSIONS 5000
+#define RUN_MS 1000
+#define PUBLISH_INTERVAL_US 500
+
+#define FANOUT_COPIES 9
+#define FRAME_SIZE 160
+
+using namespace quesync;
+
+/**
+ * Copies a frame for each participant of a channel, standing in for the per-packet fan-out.
+ *
+ * @param stream_id The stream id of the sender, mixed into the frame.
+ * @return A byte of the copies so the work can't be dropped.
+ */
+static uint32_t fanout(uint32_t stream_id) {
+    unsigned char frame[FRAME_SIZE], copies[FANOUT_COPIES][FRAME_SIZE];
+
+    memset(frame, (int)stream_id, sizeof(frame));
+    for (auto &copy : copies) {
+        memcpy(copy, frame, sizeof(frame));
+    }
+
+    return copies[stream_id % FANOUT_COPIES][stream_id % FRAME_SIZE];
+}
+
+/**
+ * Runs packet handlers on several threads while a writer keeps changing the routes, the same
+ * way joins and leaves change them while the relay handles voice.
+ *
+ * @param threads The amount of packet handling threads.
+ * @param handle_packet Finds the route of a sender, called with the index of the sender.
+ * @param change_route Changes the route of a session, called with the index of the session.
+ * @return The amount of packets handled per second by all the threads.
+ */
+template <typename Handle, typename Change>
+static double run(unsigned int threads, Handle handle_packet, Change change_route) {
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> handled(0);
+    std::vector<std::thread> handlers;
+
+    for (unsigned int t = 0; t < threads; t++) {
+        handlers.emplace_back([&, t] {
+            uint64_t count = 0, result = 0;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                result += handle_packet((t * 7919 + count) % SESSIONS);
+                count++;
+            }
+
+            handled += count;
+            bench::sink = bench::sink + result;
+        });
+    }
+
+    std::thread writer([&] {
+        for (std::size_t i = 0; !stop.load(std::memory_order_relaxed); i++) {
+            change_route(i % SESSIONS);
+            std::this_thread::sleep_for(std::chrono::microseconds(PUBLISH_INTERVAL_US));
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(RUN_MS));
+    stop = true;
+
+    for (auto &handler : handlers) {
+        handler.join();
+    }
+    writer.join();
+
+    return handled * 1000.0 / RUN_MS;
+}
+
+int main() {
+    std::mt19937 random(1);
+    std::vector<udp::endpoint> endpoints;
+
+    // Routing table published as snapshots, as the voice manager keeps it
+    std::array<std::shared_ptr<const voice::routing_shard>, ROUTING_SHARDS> routes;
+    std::mutex writer_mutex;
+
+    // Routing state behind one global mutex, as the voice manager kept it before
+    std::unordered_map<udp::endpoint, std::shared_ptr<const voice::route>, voice::endpoint_hash>
+        locked_routes;
+    std::mutex global_mutex;
+
+    for (auto &shard : routes) {
+        shard = std::make_shared<const voice::routing_shard>();
+    }
+
+    for (std::size_t i = 0; i < SESSIONS; i++) {
+        endpoints.push_back(udp::endpoint(asio::ip::address_v4((uint32_t)random()),
+                                          (unsigned short)(1024 + random() % 60000)));
+    }
+
+    // Creates a new route for a session
+    auto make_route = [](std::size_t i) {
+        std::shared_ptr<voice::route> route = std::make_shared<voice::route>();
+
+        route->session_id = std::to_string(i);
+        route->stream_id = (uint32_t)i + 1;
+
+        return std::shared_ptr<const voice::route>(route);
+    };
+    auto publish = [&](std::size_t i) {
+        std::lock_guard lk(writer_mutex);
+
+        auto &current_shard = routes[voice::endpoint_hash()(endpoints[i]) % ROUTING_SHARDS];
+        std::shared_ptr<voice::routing_shard> shard =
+            std::make_shared<voice::routing_shard>(*std::atomic_load(&current_shard));
+
+        shard->routes[endpoints[i]] = make_route(i);
+        std::atomic_store(&current_shard, std::shared_ptr<const voice::routing_shard>(shard));
+    };
+    auto update_locked = [&](std::size_t i) {
+        std::lock_guard lk(global_mutex);
+
+        locked_routes[endpoints[i]] = make_route(i);
+    };
+
+    for (std::size_t i = 0; i < SESSIONS; i++) {
+        publish(i);
+        update_locked(i);
+    }
+
+    std::cout << "Voice packets routed per second while routes change\n";
+
+    for (unsigned int threads = 1; threads <= std::max(4u, std::thread::hardware_concurrency());
+         threads *= 2) {
+        double snapshot = run(
+            threads,
+            [&](std::size_t i) {
+                std::shared_ptr<const voice::routing_shard> shard = std::atomic_load(
+                    &routes[voice::endpoint_hash()(endpoints[i]) % ROUTING_SHARDS]);
+
+                // The fan-out runs without any lock
+                return fanout(shard->routes.find(endpoints[i])->second->stream_id);
+            },
+            publish);
+
+        double locked = run(
+            threads,
+            [&](std::size_t i) {
+                // The lock was held for the whole fan-out
+                std::lock_guard lk(global_mutex);
+
+                return fanout(locked_routes.find(endpoints[i])->second->stream_id);
+            },
+            update_locked);
+
+        bench::report(std::to_string(threads) + " threads, snapshots", snapshot, "packets/s");
+        bench::report(std::to_string(threads) + " threads, global mutex", locked, "packets/s");
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <atomic>
+#include <cxxopts.hpp>
+#include <string>
+#include <termcolor/termcolor.hpp>
+#include <thread>
+
+#include "../../shared/bench/bench.h"
+#include "../src/database_executor.h"
+#include "../src/sql_pool.h"
+
+#define QUERIES_PER_REQUEST 4
+
+using namespace quesync;
+
+/**
+ * Runs requests on the database threads for a while with a pool of a given size.
+ *
+ * @param uri The URI of the SQL server.
+ * @param pool_size The max amount of sessions of the pool.
+ * @param threads The amount of database threads.
+ * @param duration The time in seconds to run the requests for.
+ * @return The statistics of the pool and the amount of requests completed per second.
+ */
+static std::pair<server::sql_pool_stats, double> run(std::string uri, unsigned int pool_size,
+                                                     unsigned int threads,
+                                                     unsigned int duration) {
+    asio::io_context io_context;
+    server::sql_pool_config config;
+    std::atomic<uint64_t> completed(0), failed(0);
+    std::chrono::steady_clock::time_point end;
+
+    config.min_size = pool_size;
+    config.max_size = pool_size;
+    config.idle_timeout = 0;
+
+    server::sql_pool pool(uri, config, io_context);
+    std::unique_ptr<server::database_executor> executor =
+        std::make_unique<server::database_executor>(io_context, threads,
+                                                    DATABASE_DEFAULT_MAX_QUEUED_JOBS);
+
+    // Keep the database threads busy with requests, each runs a few queries like a request that
+    // checks a channel and it's members before writing
+    end = std::chrono::steady_clock::now() + std::chrono::seconds(duration);
+    while (std::chrono::steady_clock::now() < end) {
+        bool queued = executor->post([&pool, &completed, &failed, &end] {
+            server::sql_request_scope request_scope;
+
+            try {
+                for (int i = 0; i < QUERIES_PER_REQUEST; i++) {
+                    server::sql_lease sql_sess = pool.lease();
+
+                    sql_sess->sql("SELECT 1").execute();
+                }
+
+                // Requests that finish while the queue drains aren't counted
+                if (std::chrono::steady_clock::now() < end) {
+                    completed++;
+                }
+            } catch (...) {
+                failed++;
+            }
+        });
+
+        // If the queue is full, let the database threads catch up
+        if (!queued) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Wait for the queued requests before closing the pool
+    executor.reset();
+    pool.close();
+
+    if (failed) {
+        std::cout << failed << " requests failed\n";
+    }
+
+    return {pool.stats(), (double)completed / duration};
+}
+
+int main(int argc, char *argv[]) {
+    cxxopts::Options options("Quesync SQL pool benchmark",
+                             "Requests per second of the database threads for pool sizes");
+
+    options.add_options()("h,sql-host", "MySQL Server Host / IP",
+                          cxxopts::value<std::string>()->default_value("localhost"))(
+        "u,sql-username", "MySQL User Name",
+        cxxopts::value<std::string>()->default_value("server"))(
+        "p,sql-password", "MySQL User Password",
+        cxxopts::value<std::string>()->default_value("123456789"))(
+        "d,db-threads", "Amount of threads that handle the requests' database work",
+        cxxopts::value<unsigned int>()->default_value(std::to_string(DATABASE_DEFAULT_THREADS)))(
+        "r,duration", "Seconds to run each pool size for",
+        cxxopts::value<unsigned int>()->default_value("5"))("help", "Print help");
+
+    try {
+        auto opts_res = options.parse(argc, argv);
+        unsigned int threads = opts_res["db-threads"].as<unsigned int>();
+        std::string uri = opts_res["sql-username"].as<std::string>() + ":" +
+                          opts_res["sql-password"].as<std::string>() + "@" +
+                          opts_res["sql-host"].as<std::string>() + "/quesync";
+
+        if (opts_res.count("help")) {
+            std::cout << options.help({"", "Group"}) << std::endl;
+            return 0;
+        }
+
+        std::cout << "Requests per second with " << threads << " database threads and "
+                  << QUERIES_PER_REQUEST << " queries per request\n";
+
+        for (unsigned int pool_size : {1, 2, 4, 8, 16}) {
+            auto [stats, requests] =
+                run(uri, pool_size, threads, opts_res["duration"].as<unsigned int>());
+
+            bench::report(std::to_string(pool_size) + " sessions, requests", requests, "/s");
+            bench::report(std::to_string(pool_size) + " sessions, average lease wait",
+                          stats.average_wait, "ms");
+            bench::report(std::to_string(pool_size) + " sessions, average lease hold",
+                          stats.average_hold, "ms");
+        }
+    } catch (std::exception &ex) {
+        std::cout << termcolor::red << "Exception occurred: " << ex.what() << termcolor::reset
+                  << "\n";
+        return 1;
+    }
+
+    return 0;
+}
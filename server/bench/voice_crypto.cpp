@@ -0,0 +1,62 @@
+#include <string>
+
+#include "../../shared/bench/bench.h"
+#include "../../shared/packets/voice_packet.h"
+#include "../../shared/utils/encryption.h"
+
+#define FRAMES 200000
+
+#define OPUS_FRAME_SIZE 160
+
+using namespace quesync;
+
+int main() {
+    std::string voice_data(OPUS_FRAME_SIZE, 'v');
+    packets::voice_packet packet(1, 0, 0, 30, voice_data.data(), OPUS_FRAME_SIZE);
+    packets::voice_packet decoded;
+    std::string encoded = packet.encode(), encrypted;
+
+    std::shared_ptr<unsigned char> aes_key = utils::rand::bytes(AES_KEY_SIZE),
+                                   hmac_key = utils::rand::bytes(HMAC_KEY_SIZE),
+                                   aead_key = utils::rand::bytes(AEAD_KEY_SIZE);
+    utils::crypto::aead sender(aead_key.get(), VOICE_CLIENT_NONCE_PREFIX),
+        receiver(aead_key.get(), VOICE_SERVER_NONCE_PREFIX);
+
+    std::string cbc_encrypted = utils::encryption::encrypt_voice_packet<packets::voice_packet>(
+        &packet, aes_key.get(), hmac_key.get());
+    std::string gcm_encrypted = utils::encryption::encrypt_voice_data(encoded, &sender);
+
+    std::cout << "Voice frame encryption with a " << OPUS_FRAME_SIZE << " bytes opus frame\n";
+
+    double cbc_seal = bench::measure(FRAMES, [&](std::size_t) {
+        return utils::encryption::encrypt_voice_packet<packets::voice_packet>(
+                   &packet, aes_key.get(), hmac_key.get())
+            .length();
+    });
+
+    double cbc_open = bench::measure(FRAMES, [&](std::size_t) {
+        return utils::encryption::decrypt_voice_packet<packets::voice_packet>(
+                   cbc_encrypted, aes_key.get(), hmac_key.get())
+            ->voice_data_len();
+    });
+
+    // The relay seals and opens into reused buffers, so the steady state doesn't allocate
+    double gcm_seal = bench::measure(FRAMES, [&](std::size_t) {
+        packet.encode(encoded);
+
+        return utils::encryption::encrypt_voice_data(encoded.data(), encoded.length(), &sender,
+                                                     encrypted);
+    });
+
+    double gcm_open = bench::measure(FRAMES, [&](std::size_t) {
+        return utils::encryption::decrypt_voice_packet(gcm_encrypted.data(),
+                                                       gcm_encrypted.length(), &receiver, decoded);
+    });
+
+    bench::report("Seal, AES-256-CBC + HMAC-SHA1", cbc_seal, "ns/frame");
+    bench::report("Open, AES-256-CBC + HMAC-SHA1", cbc_open, "ns/frame");
+    bench::report("Seal, AES-256-GCM", gcm_seal, "ns/frame");
+    bench::report("Open, AES-256-GCM", gcm_open, "ns/frame");
+
+    return 0;
+}
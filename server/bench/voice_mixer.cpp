@@ -0,0 +1,78 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "../../shared/bench/bench.h"
+#include "../src/voice_mixer.h"
+
+#define SPEAKERS 3
+#define SOURCE_FRAMES 100
+#define TICKS 500
+
+using namespace quesync;
+
+/**
+ * Encodes a few seconds of a tone for each speaker, so the mixer decodes real opus data.
+ *
+ * @param speakers The amount of speakers.
+ * @return The encoded frames of each speaker.
+ */
+static std::vector<std::vector<std::string>> encode_speakers(unsigned int speakers) {
+    std::vector<std::vector<std::string>> streams(speakers);
+    int16_t pcm[MIX_FRAME_SIZE];
+    unsigned char encoded[MIX_MAX_PACKET_LEN];
+    int error = 0, len = 0;
+
+    for (unsigned int s = 0; s < speakers; s++) {
+        std::unique_ptr<OpusEncoder, decltype(&opus_encoder_destroy)> encoder(
+            opus_encoder_create(MIX_FREQUENCY, 1, OPUS_APPLICATION_VOIP, &error),
+            &opus_encoder_destroy);
+
+        for (unsigned int f = 0; f < SOURCE_FRAMES; f++) {
+            for (int i = 0; i < MIX_FRAME_SIZE; i++) {
+                pcm[i] = (int16_t)(8000 * std::sin((f * MIX_FRAME_SIZE + i) * (s + 2) * 0.01));
+            }
+
+            len = opus_encode(encoder.get(), pcm, MIX_FRAME_SIZE, encoded, MIX_MAX_PACKET_LEN);
+            streams[s].push_back(len > 0 ? std::string((char *)encoded, len) : "");
+        }
+    }
+
+    return streams;
+}
+
+int main() {
+    std::vector<std::vector<std::string>> streams = encode_speakers(SPEAKERS);
+
+    std::cout << "Voice mixer CPU time per " << MIX_INTERVAL_MS << " ms tick with " << SPEAKERS
+              << " speakers\n";
+
+    for (unsigned int participants : {5, 10, 25, 50, 100}) {
+        server::voice_mixer mixer;
+        std::vector<uint32_t> listeners;
+
+        for (unsigned int i = 0; i < participants; i++) {
+            listeners.push_back(i + 1);
+        }
+
+        // Each tick the speakers send a frame and the channel is mixed for all the listeners
+        double tick = bench::measure(TICKS, [&](std::size_t t) {
+            for (unsigned int s = 0; s < SPEAKERS; s++) {
+                const std::string &frame = streams[s][t % SOURCE_FRAMES];
+
+                mixer.push(packets::voice_packet(s + 1, (uint16_t)t,
+                                                 (uint32_t)(t * MIX_FRAME_SIZE), 30, frame.data(),
+                                                 (unsigned int)frame.length()));
+            }
+
+            return mixer.mix(listeners).size();
+        });
+
+        bench::report(std::to_string(participants) + " participants, per tick", tick / 1000,
+                      "us");
+        bench::report(std::to_string(participants) + " participants, channels per core",
+                      MIX_INTERVAL_MS * 1e6 / tick, "channels");
+    }
+
+    return 0;
+}
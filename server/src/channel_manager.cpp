@@ -12,7 +12,7 @@ quesync::server::channel_manager::channel_manager(std::shared_ptr<quesync::serve
     : manager(server) {}
 
 bool quesync::server::channel_manager::does_channel_exists(std::string channel_id) {
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table channels_table(_server->get_sql_schema(sql_sess), "channels");
 
     try {
@@ -30,7 +30,7 @@ std::shared_ptr<quesync::channel> quesync::server::channel_manager::get_private_
     std::shared_ptr<quesync::server::session> sess, std::string user_id) {
     std::shared_ptr<channel> channel;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Row channel_res;
 
     // Check if the session is authenticated
@@ -50,7 +50,7 @@ std::shared_ptr<quesync::channel> quesync::server::channel_manager::get_private_
 
     // Try to get the private channel of the 2 users
     try {
-        channel_res = sql_sess.sql("CALL get_private_channel(?, ?);")
+        channel_res = sql_sess->sql("CALL get_private_channel(?, ?);")
                           .bind(sess->user()->id)
                           .bind(user_id)
                           .execute()
@@ -77,7 +77,7 @@ std::shared_ptr<quesync::channel> quesync::server::channel_manager::get_private_
 
 bool quesync::server::channel_manager::is_user_member_of_channel(std::string user_id,
                                                                  std::string channel_id) {
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table channel_members_table(_server->get_sql_schema(sql_sess), "channel_members");
 
     try {
@@ -94,7 +94,7 @@ bool quesync::server::channel_manager::is_user_member_of_channel(std::string use
 
 void quesync::server::channel_manager::add_member_to_channel(std::string channel_id,
                                                              std::string member_id) {
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table channel_members_table(_server->get_sql_schema(sql_sess), "channel_members");
 
     // If the channel is not found, throw error
@@ -121,7 +121,7 @@ std::shared_ptr<quesync::channel> quesync::server::channel_manager::get_channel(
     std::string channel_id) {
     std::shared_ptr<channel> channel;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table channels_table(_server->get_sql_schema(sql_sess), "channels");
     sql::Row channel_res;
 
@@ -172,7 +172,7 @@ std::vector<std::string> quesync::server::channel_manager::get_channel_members(
     std::shared_ptr<quesync::server::session> sess, std::string channel_id) {
     std::vector<std::string> members;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table channel_members_table(_server->get_sql_schema(sql_sess), "channel_members");
     sql::RowResult res;
     sql::Row row;
@@ -0,0 +1,138 @@
+#include "database_executor.h"
+
+#include <iostream>
+#include <termcolor/termcolor.hpp>
+
+quesync::server::database_executor::database_executor(asio::io_context &io_context,
+                                                       unsigned int threads,
+                                                       std::size_t max_queued_jobs,
+                                                       unsigned int stats_interval)
+    : _max_queued_jobs(max_queued_jobs),
+      _max_queued(0),
+      _jobs_count(0),
+      _rejected(0),
+      _total_wait(0),
+      _max_wait(0),
+      _stop(false),
+      _stats_interval(stats_interval),
+      _stats_timer(io_context) {
+    // Start the database threads
+    for (unsigned int i = 0; i < std::max(1u, threads); i++) {
+        _threads.push_back(std::thread(&database_executor::worker, this));
+    }
+
+    // Start printing the statistics
+    if (_stats_interval) {
+        _stats_timer.expires_after(std::chrono::seconds(_stats_interval));
+        schedule_stats();
+    }
+}
+
+quesync::server::database_executor::~database_executor() {
+    _stats_timer.cancel();
+
+    {
+        std::lock_guard lk(_mutex);
+
+        _stop = true;
+    }
+
+    // Wake the database threads and wait for them to finish their jobs
+    _cv.notify_all();
+    for (auto &thread : _threads) {
+        if (thread.joinable()) thread.join();
+    }
+}
+
+bool quesync::server::database_executor::post(std::function<void()> job) {
+    {
+        std::lock_guard lk(_mutex);
+
+        // If the queue is full, reject the job
+        if (_jobs.size() >= _max_queued_jobs) {
+            _rejected++;
+
+            return false;
+        }
+
+        _jobs.push_back({job, std::chrono::steady_clock::now()});
+
+        // Update the high-water mark of the queue
+        _max_queued = std::max(_max_queued, _jobs.size());
+    }
+
+    _cv.notify_one();
+
+    return true;
+}
+
+void quesync::server::database_executor::worker() {
+    while (true) {
+        queued_job job;
+
+        {
+            std::unique_lock lk(_mutex);
+
+            // Wait for a job
+            _cv.wait(lk, [this] { return _stop || !_jobs.empty(); });
+            if (_jobs.empty()) {
+                break;
+            }
+
+            job = std::move(_jobs.front());
+            _jobs.pop_front();
+
+            // Count the time the job waited for a thread
+            auto wait = std::chrono::steady_clock::now() - job.queued;
+            _jobs_count++;
+            _total_wait += wait;
+            _max_wait = std::max(_max_wait, wait);
+        }
+
+        try {
+            job.job();
+        } catch (std::exception &ex) {
+            std::cout << termcolor::red << "Exception occurred in a database job: " << ex.what()
+                      << termcolor::reset << "\n";
+        } catch (...) {
+            std::cout << termcolor::red << "An unknown error has occurred in a database job!"
+                      << termcolor::reset << "\n";
+        }
+    }
+}
+
+quesync::server::database_stats quesync::server::database_executor::stats() {
+    std::lock_guard lk(_mutex);
+
+    return database_stats{
+        _jobs.size(),
+        _max_queued,
+        _jobs_count,
+        _rejected,
+        _jobs_count
+            ? std::chrono::duration<double, std::milli>(_total_wait).count() / _jobs_count
+            : 0,
+        std::chrono::duration<double, std::milli>(_max_wait).count()};
+}
+
+void quesync::server::database_executor::schedule_stats() {
+    _stats_timer.async_wait([this](std::error_code ec) {
+        if (ec) {
+            return;
+        }
+
+        print_stats();
+
+        _stats_timer.expires_at(_stats_timer.expiry() + std::chrono::seconds(_stats_interval));
+        schedule_stats();
+    });
+}
+
+void quesync::server::database_executor::print_stats() {
+    database_stats stats = this->stats();
+
+    std::cout << termcolor::cyan << "Database: queued " << stats.queued << " (max "
+              << stats.max_queued << "), jobs " << stats.jobs << ", rejected " << stats.rejected
+              << ", wait " << stats.average_wait << " ms (max " << stats.max_wait << " ms)"
+              << termcolor::reset << "\n";
+}
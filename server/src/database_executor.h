@@ -0,0 +1,127 @@
+#pragma once
+
+#include <asio.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define DATABASE_DEFAULT_THREADS 4
+#define DATABASE_DEFAULT_MAX_QUEUED_JOBS 1024
+
+namespace quesync {
+namespace server {
+struct database_stats {
+    /// The amount of jobs waiting for a database thread.
+    std::size_t queued;
+
+    /// The max amount of jobs that waited for a database thread at once.
+    std::size_t max_queued;
+
+    /// The amount of jobs that ran and that were rejected since the queue was full.
+    uint64_t jobs;
+    uint64_t rejected;
+
+    /// The average and max time a job waited for a database thread in milliseconds.
+    double average_wait;
+    double max_wait;
+};
+
+class database_executor {
+   public:
+    /**
+     * Database executor constructor.
+     *
+     * @param io_context The I/O context to run the statistics timer on.
+     * @param threads The amount of database threads.
+     * @param max_queued_jobs The max amount of jobs waiting for a database thread.
+     * @param stats_interval The interval in seconds to print the statistics in, 0 for never.
+     */
+    database_executor(asio::io_context &io_context, unsigned int threads,
+                      std::size_t max_queued_jobs, unsigned int stats_interval = 0);
+    ~database_executor();
+
+    /**
+     * Queues a job to run on a database thread.
+     *
+     * @param job The job to run.
+     * @return False if the queue is full and the job was rejected.
+     */
+    bool post(std::function<void()> job);
+
+    /**
+     * Queues a job to run on a database thread and completes with it's result on an executor.
+     *
+     * @param job The job to run, it's result is passed to the completion handler.
+     * @param executor The executor to run the completion handler on, such as a strand.
+     * @param completion The completion handler.
+     * @param failure The result to complete with if the job throws.
+     * @return False if the queue is full and the job was rejected.
+     */
+    template <typename Job, typename Executor, typename Completion, typename Result>
+    bool async(Job job, Executor &executor, Completion completion, Result failure) {
+        return post([job, &executor, completion, failure] {
+            Result result;
+
+            try {
+                result = job();
+            } catch (...) {
+                // Complete with the failure result so the caller isn't left waiting for it, the
+                // error itself is logged by the database thread
+                asio::post(executor, [completion, failure] { completion(failure); });
+                throw;
+            }
+
+            asio::post(executor, [completion, result] { completion(result); });
+        });
+    }
+
+    /**
+     * Get the statistics of the executor.
+     *
+     * @return The statistics of the executor.
+     */
+    database_stats stats();
+
+   private:
+    struct queued_job {
+        std::function<void()> job;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    /// The jobs waiting for a database thread.
+    std::deque<queued_job> _jobs;
+
+    /// The max amount of jobs waiting for a database thread.
+    std::size_t _max_queued_jobs;
+
+    /// The counters of the executor.
+    std::size_t _max_queued;
+    uint64_t _jobs_count;
+    uint64_t _rejected;
+    std::chrono::steady_clock::duration _total_wait;
+    std::chrono::steady_clock::duration _max_wait;
+
+    /// Should the database threads stop.
+    bool _stop;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+
+    std::vector<std::thread> _threads;
+
+    /// The interval in seconds to print the statistics in and it's timer.
+    unsigned int _stats_interval;
+    asio::steady_timer _stats_timer;
+
+    void worker();
+
+    void schedule_stats();
+    void print_stats();
+};
+};  // namespace server
+};  // namespace quesync
@@ -95,7 +95,7 @@ void quesync::server::file_manager::init_download_file(
     std::shared_ptr<quesync::server::session> sess, std::string file_id) {
     std::shared_ptr<file> file;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table files_table(_server->get_sql_schema(sql_sess), "files");
     sql::Row res;
 
@@ -168,7 +168,7 @@ void quesync::server::file_manager::stop_file_transmission(
 }
 
 bool quesync::server::file_manager::does_file_exists(std::string file_id) {
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table files_table(_server->get_sql_schema(sql_sess), "files");
 
     try {
@@ -182,7 +182,7 @@ bool quesync::server::file_manager::does_file_exists(std::string file_id) {
 std::shared_ptr<quesync::file> quesync::server::file_manager::get_file_info(std::string file_id) {
     std::shared_ptr<file> file;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table files_table(_server->get_sql_schema(sql_sess), "files");
     sql::Row res;
 
@@ -254,7 +254,7 @@ quesync::server::file_manager::get_file_chunks(std::string file_id) {
 }
 
 void quesync::server::file_manager::save_file(std::shared_ptr<quesync::memory_file> file) {
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table files_table(_server->get_sql_schema(sql_sess), "files");
 
     try {
@@ -1,7 +1,9 @@
-#include <chrono>
+#include <algorithm>
 #include <cxxopts.hpp>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include <vector>
 
 #include "server.h"
 
@@ -10,12 +12,16 @@
 
 int main(int argc, char *argv[]) {
     asio::io_context io_context;
+    std::vector<std::unique_ptr<asio::io_context>> core_contexts;
+    std::vector<asio::io_context *> io_contexts{&io_context};
     std::vector<std::thread> threads;
+    std::vector<asio::executor_work_guard<asio::io_context::executor_type>> work_guards;
+    quesync::server::sql_pool_config sql_config;
 
     std::shared_ptr<quesync::server::server> server;
 
-    // Get the max amount of threads and dividing 1 from it because of the voice states thread
-    unsigned int amount_of_threads = std::thread::hardware_concurrency() - 1;
+    // Get the max amount of threads, voice states expire on these threads too
+    unsigned int amount_of_threads = std::max(1u, std::thread::hardware_concurrency());
 
     cxxopts::Options options("Quesync Server",
                              "Cross-Platform Secured VoIP application server optimized for Low Latency");
@@ -26,7 +32,37 @@ int main(int argc, char *argv[]) {
         "u,sql-username", "MySQL User Name",
         cxxopts::value<std::string>()->default_value("server"))(
         "p,sql-password", "MySQL User Password",
-        cxxopts::value<std::string>()->default_value("123456789"))("help", "Print help");
+        cxxopts::value<std::string>()->default_value("123456789"))(
+        "v,voice-sockets", "Amount of voice sockets, each handled by a dedicated thread",
+        cxxopts::value<unsigned int>()->default_value("1"))(
+        "b,voice-batch-io", "Receive and send voice packets in batches (Linux only)")(
+        "m,voice-max-speakers", "Forward only the loudest speakers of each channel (0 for all)",
+        cxxopts::value<unsigned int>()->default_value("0"))(
+        "x,voice-mix-threshold", "Mix the voice of channels with this many participants (0 never)",
+        cxxopts::value<unsigned int>()->default_value("0"))(
+        "s,voice-stats-interval", "Print the voice stream statistics every N seconds (0 never)",
+        cxxopts::value<unsigned int>()->default_value("0"))(
+        "c,core-contexts", "Run an I/O context with it's own TCP acceptor on each thread")(
+        "d,db-threads", "Amount of threads that handle the requests' database work",
+        cxxopts::value<unsigned int>()->default_value(std::to_string(DATABASE_DEFAULT_THREADS)))(
+        "q,db-queue-size", "Max amount of requests waiting for a database thread",
+        cxxopts::value<unsigned int>()->default_value(
+            std::to_string(DATABASE_DEFAULT_MAX_QUEUED_JOBS)))(
+        "t,db-stats-interval", "Print the database statistics every N seconds (0 never)",
+        cxxopts::value<unsigned int>()->default_value("0"))(
+        "sql-pool-min", "Amount of SQL sessions kept open even when idle",
+        cxxopts::value<unsigned int>()->default_value(std::to_string(SQL_POOL_DEFAULT_MIN_SIZE)))(
+        "sql-pool-max", "Max amount of open SQL sessions",
+        cxxopts::value<unsigned int>()->default_value(std::to_string(SQL_POOL_DEFAULT_MAX_SIZE)))(
+        "sql-idle-timeout", "Close SQL sessions idle for N seconds (0 never)",
+        cxxopts::value<unsigned int>()->default_value(
+            std::to_string(SQL_POOL_DEFAULT_IDLE_TIMEOUT)))(
+        "sql-queue-timeout", "Fail requests waiting N milliseconds for an SQL session",
+        cxxopts::value<unsigned int>()->default_value(
+            std::to_string(SQL_POOL_DEFAULT_QUEUE_TIMEOUT)))(
+        "session-stats-interval", "Print the session write queue statistics every N seconds",
+        cxxopts::value<unsigned int>()->default_value("0"))(
+        "help", "Print help");
 
     std::cout << termcolor::green << termcolor::bold << "Quesync Server v1.0.0"
               << "\n";
@@ -46,10 +82,33 @@ int main(int argc, char *argv[]) {
 
         std::cout << termcolor::blue << "Initializing Quesync server.." << termcolor::reset << "\n";
 
+        // Create an I/O context for each of the other threads, each of them is run by a single
+        // thread so the sessions pinned to it never run concurrently
+        if (opts_res["core-contexts"].as<bool>()) {
+            for (unsigned int i = 1; i < amount_of_threads; i++) {
+                core_contexts.push_back(std::make_unique<asio::io_context>(1));
+                io_contexts.push_back(core_contexts.back().get());
+            }
+        }
+
+        // Size the pool of SQL sessions, it's statistics are printed with the database's
+        sql_config.min_size = opts_res["sql-pool-min"].as<unsigned int>();
+        sql_config.max_size = opts_res["sql-pool-max"].as<unsigned int>();
+        sql_config.idle_timeout = opts_res["sql-idle-timeout"].as<unsigned int>();
+        sql_config.queue_timeout = opts_res["sql-queue-timeout"].as<unsigned int>();
+        sql_config.stats_interval = opts_res["db-stats-interval"].as<unsigned int>();
+
         // Create the Quesync server
         server = std::make_shared<quesync::server::server>(
-            io_context, opts_res["sql-host"].as<std::string>(),
-            opts_res["sql-username"].as<std::string>(), opts_res["sql-password"].as<std::string>());
+            io_contexts, opts_res["sql-host"].as<std::string>(),
+            opts_res["sql-username"].as<std::string>(), opts_res["sql-password"].as<std::string>(),
+            opts_res["voice-sockets"].as<unsigned int>(), opts_res["voice-batch-io"].as<bool>(),
+            opts_res["voice-max-speakers"].as<unsigned int>(),
+            opts_res["voice-mix-threshold"].as<unsigned int>(),
+            opts_res["voice-stats-interval"].as<unsigned int>(),
+            opts_res["db-threads"].as<unsigned int>(), opts_res["db-queue-size"].as<unsigned int>(),
+            opts_res["db-stats-interval"].as<unsigned int>(), sql_config,
+            opts_res["session-stats-interval"].as<unsigned int>());
 
         std::cout << termcolor::blue << "Testing MySQL connection.." << termcolor::reset << "\n";
 
@@ -58,17 +117,24 @@ int main(int argc, char *argv[]) {
 
         std::cout << termcolor::blue << "Starting threads.." << termcolor::reset << "\n";
 
+        // Keep the contexts running while they have no pending handlers
+        for (auto context : io_contexts) {
+            work_guards.push_back(asio::make_work_guard(*context));
+        }
+
         // Start the threads
         for (unsigned int i = 0; i < amount_of_threads; i++) {
             std::cout << termcolor::blue << "Starting thread no. " << i + 1 << ".."
                       << termcolor::reset << "\n";
 
-            threads.push_back(std::thread([&] {
-                while (true) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            // Run the context of the thread, or the main context when the contexts are shared
+            asio::io_context &thread_context = *io_contexts[i % io_contexts.size()];
 
+            threads.push_back(std::thread([&thread_context] {
+                // The context has work until it's stopped, so run only returns on exceptions
+                while (!thread_context.stopped()) {
                     try {
-                        io_context.run();
+                        thread_context.run();
                     } catch (std::exception &ex) {
                         std::cout << termcolor::red << "Exception occurred in thread "
                                   << std::this_thread::get_id() << " : " << ex.what()
@@ -22,7 +22,7 @@ std::shared_ptr<quesync::message> quesync::server::message_manager::send_message
 
     std::shared_ptr<events::message_event> message_evt;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table messages_table(_server->get_sql_schema(sql_sess), "messages");
 
     // Check if the session is authenticated
@@ -87,7 +87,7 @@ std::vector<quesync::message> quesync::server::message_manager::get_messages(
     unsigned int offset) {
     std::vector<message> messages;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table messages_table(_server->get_sql_schema(sql_sess), "messages");
     sql::RowResult res;
     sql::Row row;
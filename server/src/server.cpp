@@ -1,5 +1,6 @@
 #include "server.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
 #include <iostream>
@@ -9,18 +10,54 @@
 #include "database_dump.h"
 #include "session.h"
 
-quesync::server::server::server(asio::io_context &io_context, std::string sql_server_ip,
-                                std::string sql_username, std::string sql_password)
-    : _acceptor(io_context, tcp::endpoint(tcp::v4(), MAIN_SERVER_PORT)),
+#include "../../shared/utils/socket_options.h"
+
+quesync::server::server::server(std::vector<asio::io_context *> io_contexts,
+                                std::string sql_server_ip, std::string sql_username,
+                                std::string sql_password, unsigned int voice_sockets,
+                                bool voice_batch_io, unsigned int voice_max_speakers,
+                                unsigned int voice_mix_threshold,
+                                unsigned int voice_stats_interval,
+                                unsigned int database_threads,
+                                unsigned int database_queue_size,
+                                unsigned int database_stats_interval,
+                                quesync::server::sql_pool_config sql_config,
+                                unsigned int session_stats_interval)
+    : _io_contexts(io_contexts),
+      _next_context(0),
       _context(asio::ssl::context::sslv23),
-      _sql_cli(server::format_uri(sql_server_ip, sql_username, sql_password)) {
+      _voice_sockets(voice_sockets),
+      _voice_batch_io(voice_batch_io),
+      _voice_max_speakers(voice_max_speakers),
+      _voice_mix_threshold(voice_mix_threshold),
+      _voice_stats_interval(voice_stats_interval),
+      _queued_frames(0),
+      _slow_sessions(0),
+      _write_queue_high_water(0),
+      _session_stats_interval(session_stats_interval),
+      _session_stats_timer(get_io_context()) {
     // Init SSL context
     _context.set_options(asio::ssl::context::default_workarounds | asio::ssl::context::no_sslv2);
     _context.use_certificate_chain_file("server.pem");
     _context.use_private_key_file("server.pem", asio::ssl::context::pem);
 
+    // Start the database threads
+    _database_executor = std::make_shared<quesync::server::database_executor>(
+        get_io_context(), database_threads, database_queue_size, database_stats_interval);
+
+    // Open the acceptors of the main port
+    open_acceptors();
+
     // Import database dump
     import_database(sql_server_ip, sql_username, sql_password);
+
+    // Keep a session for the I/O threads even when every database thread holds one
+    sql_config.max_size = std::max(sql_config.max_size, std::max(1u, database_threads) + 1);
+
+    // Open the pool of SQL sessions, after the import since the sessions use the database
+    _sql_pool = std::make_shared<quesync::server::sql_pool>(
+        server::format_uri(sql_server_ip, sql_username, sql_password), sql_config,
+        get_io_context());
 }
 
 void quesync::server::server::import_database(std::string sql_server_ip, std::string sql_username,
@@ -95,10 +132,16 @@ std::string quesync::server::server::to_hex_string(std::string str) {
 
 quesync::server::server::~server() {
     // Close all socket handlers
-    _acceptor.cancel();
+    for (auto &acceptor : _acceptors) {
+        acceptor->cancel();
+    }
+    _session_stats_timer.cancel();
+
+    // Wait for the database threads to finish the queued jobs before closing their SQL sessions
+    _database_executor.reset();
 
     // Close all SQL sessions
-    _sql_cli.close();
+    _sql_pool->close();
 }
 
 void quesync::server::server::start() {
@@ -108,25 +151,101 @@ void quesync::server::server::start() {
     _channel_manager = std::make_shared<quesync::server::channel_manager>(shared_from_this());
     _message_manager = std::make_shared<quesync::server::message_manager>(shared_from_this());
     _session_manager = std::make_shared<quesync::server::session_manager>(shared_from_this());
-    _voice_manager = std::make_shared<quesync::server::voice_manager>(shared_from_this());
+    _voice_manager = std::make_shared<quesync::server::voice_manager>(
+        shared_from_this(), _voice_sockets, _voice_batch_io, _voice_max_speakers,
+        _voice_mix_threshold, _voice_stats_interval);
     _file_manager = std::make_shared<quesync::server::file_manager>(shared_from_this());
 
     std::cout << termcolor::cyan << "Listening for TCP connections.." << termcolor::reset
               << std::endl;
 
     // Start acception requests
-    accept_client();
+    for (auto &acceptor : _acceptors) {
+        accept_client(*acceptor);
+    }
+    // Start printing the session statistics
+    if (_session_stats_interval) {
+        _session_stats_timer.expires_after(std::chrono::seconds(_session_stats_interval));
+        schedule_session_stats();
+    }
 }
 
-asio::io_context &quesync::server::server::get_io_context() {
-    return (asio::io_context &)_acceptor.get_executor().context();
+void quesync::server::server::open_acceptors() {
+    tcp::endpoint endpoint(tcp::v4(), MAIN_SERVER_PORT);
+
+#ifdef SO_REUSEPORT
+    // Open an acceptor on each I/O context and bind all of them to the main port, the kernel
+    // spreads the connections between them
+    if (_io_contexts.size() > 1) {
+        for (auto io_context : _io_contexts) {
+            _acceptors.push_back(std::make_unique<tcp::acceptor>(*io_context));
+            _acceptors.back()->open(endpoint.protocol());
+            _acceptors.back()->set_option(tcp::acceptor::reuse_address(true));
+            _acceptors.back()->set_option(utils::reuse_port(true));
+            _acceptors.back()->bind(endpoint);
+            _acceptors.back()->listen();
+        }
+
+        return;
+    }
+#endif
+
+    // A single acceptor on the main I/O context
+    _acceptors.push_back(std::make_unique<tcp::acceptor>(*_io_contexts.front(), endpoint));
 }
 
+asio::io_context &quesync::server::server::get_io_context() { return *_io_contexts.front(); }
+
 asio::ssl::context &quesync::server::server::get_ssl_context() { return _context; }
 
-void quesync::server::server::accept_client() {
+void quesync::server::server::count_queued_frame(std::size_t depth) {
+    std::size_t high_water = _write_queue_high_water;
+
+    _queued_frames++;
+
+    // Raise the high-water mark if the depth passed it
+    while (depth > high_water &&
+           !_write_queue_high_water.compare_exchange_weak(high_water, depth)) {
+    }
+}
+
+void quesync::server::server::count_slow_session() { _slow_sessions++; }
+
+quesync::server::session_stats quesync::server::server::get_session_stats() {
+    return session_stats{_queued_frames, _slow_sessions, _write_queue_high_water};
+}
+
+void quesync::server::server::schedule_session_stats() {
+    _session_stats_timer.async_wait([this](std::error_code ec) {
+        if (ec) {
+            return;
+        }
+
+        print_session_stats();
+
+        _session_stats_timer.expires_at(_session_stats_timer.expiry() +
+                                        std::chrono::seconds(_session_stats_interval));
+        schedule_session_stats();
+    });
+}
+
+void quesync::server::server::print_session_stats() {
+    session_stats stats = get_session_stats();
+
+    std::cout << termcolor::cyan << "Sessions: queued frames " << stats.queued_frames
+              << ", max queued frames " << stats.write_queue_high_water << ", slow disconnects "
+              << stats.slow_sessions << termcolor::reset << "\n";
+}
+
+void quesync::server::server::accept_client(tcp::acceptor &acceptor) {
+    // Pin the client to the I/O context of it's acceptor, a shared acceptor hands the clients to
+    // the I/O contexts in turns
+    asio::io_context &io_context =
+        _acceptors.size() > 1 ? static_cast<asio::io_context &>(acceptor.get_executor().context())
+                              : *_io_contexts[_next_context++ % _io_contexts.size()];
+
     // Start an async accept
-    _acceptor.async_accept([this](std::error_code ec, tcp::socket socket) {
+    acceptor.async_accept(io_context, [this, &acceptor](std::error_code ec, tcp::socket socket) {
         // If no error occurred during the connection to the client start a session with it
         if (!ec) {
             // Print the client ip and port
@@ -143,7 +262,7 @@ void quesync::server::server::accept_client() {
         }
 
         // Accept the next client
-        accept_client();
+        accept_client(acceptor);
     });
 }
 
@@ -175,7 +294,13 @@ std::shared_ptr<quesync::server::file_manager> quesync::server::server::file_man
     return _file_manager;
 }
 
-sql::Session quesync::server::server::get_sql_session() { return _sql_cli.getSession(); }
+std::shared_ptr<quesync::server::database_executor> quesync::server::server::database_executor() {
+    return _database_executor;
+}
+
+quesync::server::sql_lease quesync::server::server::get_sql_session() {
+    return _sql_pool->lease();
+}
 
 sql::Schema quesync::server::server::get_sql_schema(sql::Session &session) {
     return sql::Schema(session, "quesync");
@@ -2,18 +2,22 @@
 
 #include <asio.hpp>
 #include <asio/ssl.hpp>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <mysqlx/xdevapi.h>
 namespace sql = mysqlx;
 
 #include "channel_manager.h"
+#include "database_executor.h"
 #include "event_manager.h"
 #include "file_manager.h"
 #include "message_manager.h"
 #include "session_manager.h"
+#include "sql_pool.h"
 #include "user_manager.h"
 #include "voice_manager.h"
 
@@ -25,16 +29,48 @@ using asio::ip::tcp;
 
 namespace quesync {
 namespace server {
+struct session_stats {
+    /// The amount of frames queued to be written to all the sessions.
+    uint64_t queued_frames;
+
+    /// The amount of sessions disconnected since they didn't keep up with their frames.
+    uint64_t slow_sessions;
+
+    /// The max amount of frames that waited to be written to a single session at once.
+    std::size_t write_queue_high_water;
+};
+
 class server : public std::enable_shared_from_this<server> {
    public:
     /**
-     * @param io_context The I/O context.
+     * @param io_contexts The I/O contexts of the server, the first one runs the managers. When
+     *                    more than 1 context is given, each context gets it's own acceptor bound
+     *                    to the main port with SO_REUSEPORT and each session is pinned to the
+     *                    context that accepted it. Without SO_REUSEPORT, a single acceptor hands
+     *                    the clients to the contexts in turns.
      * @param sql_server_ip The IP of the SQL server.
      * @param sql_username The username to connect with to the SQL server.
      * @param sql_password The password to connect with to the SQL server.
+     * @param voice_sockets The amount of sockets to receive voice packets on.
+     * @param voice_batch_io Receive and send voice packets in batches.
+     * @param voice_max_speakers The maximum amount of speakers forwarded in each voice channel.
+     * @param voice_mix_threshold The amount of participants from which a voice channel is mixed.
+     * @param voice_stats_interval The interval in seconds to print the voice statistics in.
+     * @param database_threads The amount of threads that handle the requests' database work.
+     * @param database_queue_size The max amount of requests waiting for a database thread.
+     * @param database_stats_interval The interval in seconds to print the database statistics in.
+     * @param sql_config The sizing and timeouts of the SQL session pool, it keeps at least one
+     * session more than the database threads.
+     * @param session_stats_interval The interval in seconds to print the session statistics in.
      */
-    server(asio::io_context &io_context, std::string sql_server_ip, std::string sql_username,
-           std::string sql_password);
+    server(std::vector<asio::io_context *> io_contexts, std::string sql_server_ip,
+           std::string sql_username, std::string sql_password, unsigned int voice_sockets = 1,
+           bool voice_batch_io = false, unsigned int voice_max_speakers = 0,
+           unsigned int voice_mix_threshold = 0, unsigned int voice_stats_interval = 0,
+           unsigned int database_threads = DATABASE_DEFAULT_THREADS,
+           unsigned int database_queue_size = DATABASE_DEFAULT_MAX_QUEUED_JOBS,
+           unsigned int database_stats_interval = 0, sql_pool_config sql_config = {},
+           unsigned int session_stats_interval = 0);
     ~server();
 
     /**
@@ -43,7 +79,7 @@ class server : public std::enable_shared_from_this<server> {
     void start();
 
     /**
-     * Gets the I/O context.
+     * Gets the main I/O context, the managers' timers and sockets run on it.
      *
      * @return The I/O context.
      */
@@ -56,6 +92,25 @@ class server : public std::enable_shared_from_this<server> {
      */
     asio::ssl::context &get_ssl_context();
 
+    /**
+     * Counts a frame queued to be written to a session.
+     *
+     * @param depth The amount of frames queued for the session, including the frame.
+     */
+    void count_queued_frame(std::size_t depth);
+
+    /**
+     * Counts a session that was disconnected since it didn't keep up with it's frames.
+     */
+    void count_slow_session();
+
+    /**
+     * Get the statistics of the sessions' write queues.
+     *
+     * @return The statistics of the sessions' write queues.
+     */
+    session_stats get_session_stats();
+
     /**
      * Gets the shared pointer to the user manager.
      *
@@ -106,11 +161,18 @@ class server : public std::enable_shared_from_this<server> {
     std::shared_ptr<file_manager> file_manager();
 
     /**
-     * Gets the SQL session.
+     * Gets the shared pointer to the database executor.
      *
-     * @return The SQL session.
+     * @return A shared pointer to the database executor.
      */
-    sql::Session get_sql_session();
+    std::shared_ptr<database_executor> database_executor();
+
+    /**
+     * Leases an SQL session from the pool, all the leases of a thread share the same session.
+     *
+     * @return The lease of the SQL session.
+     */
+    sql_lease get_sql_session();
 
     /**
      * Gets the SQL scheme for the session.
@@ -121,14 +183,44 @@ class server : public std::enable_shared_from_this<server> {
     sql::Schema get_sql_schema(sql::Session &session);
 
    private:
-    /// The main TCP acceptor for the server.
-    tcp::acceptor _acceptor;
+    /// The I/O contexts of the server, the first one is the main context.
+    std::vector<asio::io_context *> _io_contexts;
+
+    /// The TCP acceptors of the main port, one per I/O context or a single shared one.
+    std::vector<std::unique_ptr<tcp::acceptor>> _acceptors;
+
+    /// The I/O context the next client of a shared acceptor is pinned to.
+    std::atomic<unsigned int> _next_context;
 
     /// The SSL/TLS context.
     asio::ssl::context _context;
 
-    /// The SQL client used to create sessions with the SQL server.
-    sql::Client _sql_cli;
+    /// The pool of the sessions with the SQL server.
+    std::shared_ptr<sql_pool> _sql_pool;
+
+    /// The amount of sockets to receive voice packets on.
+    unsigned int _voice_sockets;
+
+    /// Whether voice packets are received and sent in batches.
+    bool _voice_batch_io;
+
+    /// The maximum amount of speakers forwarded in each voice channel, 0 for no limit.
+    unsigned int _voice_max_speakers;
+
+    /// The amount of participants from which a voice channel is mixed, 0 for never.
+    unsigned int _voice_mix_threshold;
+
+    /// The interval in seconds to print the voice statistics in, 0 for never.
+    unsigned int _voice_stats_interval;
+
+    /// The counters of the sessions' write queues.
+    std::atomic<uint64_t> _queued_frames;
+    std::atomic<uint64_t> _slow_sessions;
+    std::atomic<std::size_t> _write_queue_high_water;
+
+    /// The interval in seconds to print the session statistics in and it's timer.
+    unsigned int _session_stats_interval;
+    asio::steady_timer _session_stats_timer;
 
     /// A shared pointer to the user manager object.
     std::shared_ptr<quesync::server::user_manager> _user_manager;
@@ -151,7 +243,13 @@ class server : public std::enable_shared_from_this<server> {
     /// A shared pointer to the file manager object.
     std::shared_ptr<quesync::server::file_manager> _file_manager;
 
-    void accept_client();
+    /// A shared pointer to the database executor, it's destroyed first to finish it's jobs.
+    std::shared_ptr<quesync::server::database_executor> _database_executor;
+
+    void open_acceptors();
+    void schedule_session_stats();
+    void print_session_stats();
+    void accept_client(tcp::acceptor &acceptor);
 
     static void import_database(std::string sql_server_ip, std::string sql_username,
                                 std::string sql_password);
@@ -13,7 +13,11 @@ quesync::server::session::session(tcp::socket socket, asio::ssl::context &contex
     : _socket(std::move(socket), context),                  // Copy the client's socket
       _endpoint(_socket.lowest_layer().remote_endpoint()),  // Save the client's endpoint for errors
       _server(server),                                      // Save the server for data transfer,
-      _user(nullptr) {}
+      _user(nullptr),
+      _strand(static_cast<asio::io_context &>(_socket.get_executor().context())),
+      _multiplexed(false),
+      _queued_frames_count(0),
+      _write_queue_high_water(0) {}
 
 quesync::server::session::~session() {
     std::lock_guard lk(_user_mutex);
@@ -54,11 +58,11 @@ void quesync::server::session::handshake() {
     auto self(shared_from_this());
 
     _socket.async_handshake(asio::ssl::stream_base::server,
-                            [this, self](const std::error_code &ec) {
+                            _strand.wrap([this, self](const std::error_code &ec) {
                                 if (!ec) {
                                     recv();
                                 }
-                            });
+                            }));
 }
 
 void quesync::server::session::recv() {
@@ -69,90 +73,166 @@ void quesync::server::session::recv() {
     // Get the header of the request
     asio::async_read(
         _socket, asio::buffer(header_buf, sizeof(header)),
-        [this, self, header_buf](std::error_code ec, std::size_t length) {
+        _strand.wrap([this, self, header_buf](std::error_code ec, std::size_t length) {
             header req_header = utils::parser::decode_header(header_buf);
             std::shared_ptr<char> buf = std::shared_ptr<char>(new char[req_header.size]);
 
             // Get a request from the user
             asio::async_read(
                 _socket, asio::buffer(buf.get(), req_header.size),
-                [this, self, buf, req_header](std::error_code ec, std::size_t length) {
-                    header header{1, 0};
-                    std::string header_str;
-                    std::shared_ptr<packet> packet;
-                    std::string response;
-
-                    // If no error occurred, parse the request
-                    if (!ec) {
-                        // Parse the packet
-                        packet =
-                            utils::parser::parse_packet(std::string(buf.get(), req_header.size));
-
-                        // If the packet has parsed successfully handle it
-                        if (packet) {
-                            // Handle the client's request and get a respond
-                            response = packet->handle(shared_from_this());
-                        } else {
-                            // Return an invalid packet error packet
-                            response = packets::error_packet(error::invalid_packet).encode();
-                        }
-
-                        // Set the size of the response
-                        header.size = (unsigned int)response.size();
-
-                        // Encode the header in a string
-                        header_str = utils::parser::encode_header(header);
-
-                        // Send the header + server's response to the server
-                        send(header_str + response);
-                    } else {
+                _strand.wrap([this, self, buf, req_header](std::error_code ec, std::size_t length) {
+                    std::string request;
+                    uint32_t version = PROTOCOL_VERSION;
+
+                    // If an error occurred, the client is disconnected
+                    if (ec) {
                         std::cout << termcolor::magenta << "The client "
                                   << _endpoint.address().to_string() << ":" << (int)_endpoint.port()
-                                  << " disconnected!" << termcolor::reset << std::endl;
+                                  << " disconnected! (max queued frames: "
+                                  << _write_queue_high_water << ")" << termcolor::reset
+                                  << std::endl;
+
+                        return;
+                    }
+
+                    request = std::string(buf.get(), req_header.size);
+
+                    // If the client uses the multiplexed revision, the response is sent with the
+                    // request's ID whenever it's ready
+                    if (req_header.revision() == PROTOCOL_MULTIPLEXED_VERSION) {
+                        _multiplexed = true;
+                        version = header::multiplexed_version(req_header.request_id());
+                    }
+
+                    // Handle the request on a database thread and send the response from the
+                    // strand, the next request is read meanwhile. Requests that don't touch the
+                    // database are handled on the strand, so they don't wait behind slow queries
+                    if (!uses_database(request)) {
+                        send_frame(version, handle_request(request));
+                    } else if (!_server->database_executor()->async(
+                                 [this, self, request] { return handle_request(request); },
+                                 _strand,
+                                 [this, self, version](std::string response) {
+                                     send_frame(version, response);
+                                 },
+                                 packets::error_packet(error::unknown_error).encode())) {
+                        // If the database threads are too busy, reject the request
+                        send_frame(version, packets::error_packet(error::server_busy).encode());
                     }
-                });
-        });
+
+                    recv();
+                }));
+        }));
 }
 
-void quesync::server::session::send(std::string data) {
-    auto self(shared_from_this());
+std::string quesync::server::session::handle_request(std::string request) {
+    // All the SQL calls of the request share a single session
+    sql_request_scope sql_request;
 
-    // Create a buffer with the size of the data and copy the data to it
-    std::shared_ptr<char> buf(new char[data.length()]);
-    memcpy(buf.get(), data.data(), data.length());
-
-    // Send the data to the client
-    asio::async_write(_socket, asio::buffer(buf.get(), data.length()),
-                      [this, self, buf](std::error_code ec, std::size_t) {
-                          // If no error occurred, return to the receiving function
-                          if (!ec) {
-                              recv();
-                          } else {
-                              std::cout << termcolor::magenta << "The client "
-                                        << _endpoint.address().to_string() << ":"
-                                        << (int)_endpoint.port() << " disconnected!"
-                                        << termcolor::reset << std::endl;
-                          }
-                      });
+    // Parse the packet
+    std::shared_ptr<packet> packet = utils::parser::parse_packet(request);
+
+    // If the packet has parsed successfully handle it
+    if (packet) {
+        // Handle the client's request and get a respond
+        return packet->handle(shared_from_this());
+    } else {
+        // Return an invalid packet error packet
+        return packets::error_packet(error::invalid_packet).encode();
+    }
+}
+
+bool quesync::server::session::uses_database(const std::string &request) {
+    packet_type type;
+
+    // If the packet type is invalid, the request is handled on a database thread which answers
+    // the failure
+    try {
+        type = utils::parser::get_packet_type(request);
+    } catch (...) {
+        return true;
+    }
+
+    // Pings and the requests that only change in-memory state don't use the database
+    return type != packet_type::ping_packet && type != packet_type::set_voice_state_packet &&
+           type != packet_type::file_transmission_stop_packet;
 }
 
 void quesync::server::session::send_only(std::string data) {
+    // Events are sent with the request ID 0 to clients of the multiplexed revision
+    send_frame(_multiplexed ? header::multiplexed_version(0) : PROTOCOL_VERSION, data);
+}
+
+void quesync::server::session::send_frame(uint32_t version, std::string data) {
+    auto self(shared_from_this());
+
+    header header{version, (uint32_t)data.size()};
+
+    // Queue the frame on the strand, since frames are sent from the threads of other I/O contexts
+    asio::post(_strand, [this, self, frame = utils::parser::encode_header(header) + data] {
+        // If the client doesn't keep up with it's frames, disconnect it
+        if (_queued_frames_count >= SESSION_MAX_QUEUED_FRAMES) {
+            std::cout << termcolor::magenta << "The client " << _endpoint.address().to_string()
+                      << ":" << (int)_endpoint.port() << " is too slow, disconnecting!"
+                      << termcolor::reset << std::endl;
+
+            _server->count_slow_session();
+
+            try {
+                _socket.lowest_layer().close();
+            } catch (...) {
+            }
+
+            return;
+        }
+
+        // Gather the frame with the other queued frames
+        _queued_frames += frame;
+        _queued_frames_count++;
+
+        // Update the high-water mark of the session's queue and the server's counters
+        if (_queued_frames_count > _write_queue_high_water) {
+            _write_queue_high_water = _queued_frames_count;
+        }
+        _server->count_queued_frame(_queued_frames_count);
+
+        // If no frames are being written, start writing
+        if (_written_frames.empty()) {
+            write_frames();
+        }
+    });
+}
+
+void quesync::server::session::write_frames() {
     auto self(shared_from_this());
 
-    header header{1, (uint32_t)data.length()};
+    // Take all the queued frames, they're written in a single write
+    _written_frames.swap(_queued_frames);
+    _queued_frames.clear();
+    _queued_frames_count = 0;
 
-    // Create a buffer with the size of the data and the header
-    std::shared_ptr<char> buf(new char[data.length() + sizeof(header) + 1]);
+    // Send the frames to the client
+    asio::async_write(_socket, asio::buffer(_written_frames),
+                      _strand.wrap([this, self](std::error_code ec, std::size_t) {
+                          _written_frames.clear();
 
-    // Copy the header
-    memcpy(buf.get(), utils::parser::encode_header(header).data(), sizeof(header));
+                          // If an error occurred, drop the queued frames
+                          if (ec) {
+                              _queued_frames.clear();
+                              _queued_frames_count = 0;
 
-    // Copy the data
-    memcpy(buf.get() + sizeof(header), data.data(), data.length());
+                              return;
+                          }
+
+                          // Write the frames queued meanwhile
+                          if (!_queued_frames.empty()) {
+                              write_frames();
+                          }
+                      }));
+}
 
-    // Send the data to the client
-    asio::async_write(_socket, asio::buffer(buf.get(), data.length() + sizeof(header)),
-                      [this, self, buf](std::error_code, std::size_t) {});
+size_t quesync::server::session::write_queue_high_water() const {
+    return _write_queue_high_water;
 }
 
 std::shared_ptr<quesync::server::server> quesync::server::session::server() const {
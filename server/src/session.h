@@ -2,6 +2,7 @@
 
 #include <asio.hpp>
 #include <asio/ssl.hpp>
+#include <atomic>
 #include <memory>
 #include <mutex>
 
@@ -9,6 +10,8 @@
 
 #include "../../shared/user.h"
 
+#define SESSION_MAX_QUEUED_FRAMES 1024
+
 using asio::ip::tcp;
 
 namespace quesync {
@@ -37,6 +40,13 @@ class session : public std::enable_shared_from_this<session> {
      */
     void send_only(std::string data);
 
+    /**
+     * Gets the high-water mark of the write queue.
+     *
+     * @return The max amount of frames that waited to be written at once.
+     */
+    size_t write_queue_high_water() const;
+
     /**
      * Get the shared pointer to the server object.
      *
@@ -88,11 +98,32 @@ class session : public std::enable_shared_from_this<session> {
     /// The endpoint of the user.
     tcp::endpoint _endpoint;
 
+    /// A strand used to sync send and recv on the socket.
+    asio::io_context::strand _strand;
+
+    /// Is the client using the multiplexed revision of the protocol.
+    std::atomic<bool> _multiplexed;
+
+    /// The frames waiting to be written, gathered in a single buffer. Only accessed on the strand.
+    std::string _queued_frames;
+
+    /// The amount of frames waiting to be written.
+    size_t _queued_frames_count;
+
+    /// The frames that are currently written. Only accessed on the strand.
+    std::string _written_frames;
+
+    /// The max amount of frames that waited to be written at once.
+    std::atomic<size_t> _write_queue_high_water;
+
     void clean_user_session();
 
     void handshake();
     void recv();
-    void send(std::string data);
+    std::string handle_request(std::string request);
+    static bool uses_database(const std::string &request);
+    void send_frame(uint32_t version, std::string data);
+    void write_frames();
 };
 };  // namespace server
 };  // namespace quesync
@@ -16,7 +16,7 @@ std::string quesync::server::session_manager::create_session(
     std::shared_ptr<quesync::server::session> sess) {
     std::string session_id = sole::uuid4().str();
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table sessions_table(_server->get_sql_schema(sql_sess), "sessions");
 
     // Check if the session is authenticated
@@ -39,7 +39,7 @@ std::string quesync::server::session_manager::create_session(
 std::string quesync::server::session_manager::get_user_id_for_session(std::string session_id) {
     sql::Row res;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table sessions_table(_server->get_sql_schema(sql_sess), "sessions");
 
     try {
@@ -63,7 +63,7 @@ std::string quesync::server::session_manager::get_user_id_for_session(std::strin
 
 void quesync::server::session_manager::destroy_session(
     std::shared_ptr<quesync::server::session> sess) {
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table sessions_table(_server->get_sql_schema(sql_sess), "sessions");
 
     try {
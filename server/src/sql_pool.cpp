@@ -0,0 +1,319 @@
+#include "sql_pool.h"
+
+#include <iostream>
+#include <termcolor/termcolor.hpp>
+
+#include "../../shared/exception.h"
+
+/// The session leased by the current thread, other leases on the thread share it.
+static thread_local quesync::server::sql_pooled_session *current_session = nullptr;
+
+/// Is the current thread handling a request and the lease that keeps it's session.
+static thread_local bool in_request = false;
+static thread_local std::unique_ptr<quesync::server::sql_lease> request_lease;
+
+quesync::server::sql_request_scope::sql_request_scope() { in_request = true; }
+
+quesync::server::sql_request_scope::~sql_request_scope() {
+    // Return the session of the request to the pool
+    request_lease.reset();
+    in_request = false;
+}
+
+quesync::server::sql_lease::sql_lease(quesync::server::sql_pool *pool,
+                                      quesync::server::sql_pooled_session *session, bool owner)
+    : _pool(pool), _session(session), _owner(owner) {}
+
+quesync::server::sql_lease::sql_lease(quesync::server::sql_lease &&other)
+    : _pool(other._pool), _session(other._session), _owner(other._owner) {
+    // The moved lease no longer returns the session
+    other._owner = false;
+}
+
+quesync::server::sql_lease::~sql_lease() {
+    // If this is the lease that leased the session, return it to the pool
+    if (_owner) {
+        current_session = nullptr;
+
+        _pool->release(_session);
+    }
+}
+
+sql::Session *quesync::server::sql_lease::operator->() { return &_session->session; }
+
+quesync::server::sql_lease::operator sql::Session &() { return _session->session; }
+
+quesync::server::sql_pool::sql_pool(std::string uri, quesync::server::sql_pool_config config,
+                                    asio::io_context &io_context)
+    : _client(uri, sql::ClientOption::POOLING, false),
+      _config(config),
+      _size(0),
+      _waiting(0),
+      _closed(false),
+      _leases(0),
+      _shared_leases(0),
+      _timeouts(0),
+      _opened(0),
+      _closed_sessions(0),
+      _total_wait(0),
+      _max_wait(0),
+      _total_hold(0),
+      _reap_timer(io_context),
+      _stats_timer(io_context) {
+    _config.max_size = std::max(1u, _config.max_size);
+    _config.min_size = std::min(_config.min_size, _config.max_size);
+
+    // Open the sessions that are always kept open
+    for (unsigned int i = 0; i < _config.min_size; i++) {
+        _idle.push_back(open_session());
+        _size++;
+        _opened++;
+    }
+
+    // Start closing idle sessions
+    if (_config.idle_timeout) {
+        _reap_timer.expires_after(std::chrono::milliseconds(SQL_POOL_REAP_INTERVAL_MS));
+        schedule_reap();
+    }
+
+    // Start printing the statistics
+    if (_config.stats_interval) {
+        _stats_timer.expires_after(std::chrono::seconds(_config.stats_interval));
+        schedule_stats();
+    }
+}
+
+quesync::server::sql_pool::~sql_pool() { close(); }
+
+quesync::server::sql_lease quesync::server::sql_pool::lease() {
+    std::unique_lock lk(_mutex);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::unique_ptr<sql_pooled_session> session;
+    bool ready;
+
+    // If the thread already holds a lease, share it's session
+    if (current_session) {
+        _leases++;
+        _shared_leases++;
+
+        return sql_lease(this, current_session, false);
+    }
+
+    // Wait for an idle session or for room to open a new one
+    _waiting++;
+    ready = _cv.wait_until(lk, start + std::chrono::milliseconds(_config.queue_timeout), [this] {
+        return _closed || !_idle.empty() || _size < _config.max_size;
+    });
+    _waiting--;
+
+    if (_closed) {
+        throw exception(error::unknown_error);
+    } else if (!ready) {
+        _timeouts++;
+
+        throw exception(error::server_busy);
+    }
+
+    // Take the most recently released session, the older ones are closed first when idle
+    if (!_idle.empty()) {
+        session = std::move(_idle.back());
+        _idle.pop_back();
+    } else {
+        // Open a new session without holding the lock
+        _size++;
+        lk.unlock();
+
+        try {
+            session = open_session();
+        } catch (...) {
+            lk.lock();
+            _size--;
+            lk.unlock();
+
+            _cv.notify_one();
+
+            throw;
+        }
+
+        lk.lock();
+        _opened++;
+    }
+
+    // Count the time the lease waited for the session
+    session->leased = std::chrono::steady_clock::now();
+    _leases++;
+    _total_wait += session->leased - start;
+    _max_wait = std::max(_max_wait, session->leased - start);
+
+    current_session = session.get();
+
+    // Inside a request, the request scope keeps the session until the request ends
+    if (in_request) {
+        request_lease = std::make_unique<sql_lease>(this, session.release(), true);
+
+        return sql_lease(this, current_session, false);
+    }
+
+    return sql_lease(this, session.release(), true);
+}
+
+void quesync::server::sql_pool::release(quesync::server::sql_pooled_session *session) {
+    std::unique_ptr<sql_pooled_session> pooled_session(session);
+
+    {
+        std::lock_guard lk(_mutex);
+
+        // Count the time the session was held
+        pooled_session->released = std::chrono::steady_clock::now();
+        _total_hold += pooled_session->released - pooled_session->leased;
+
+        // If the pool wasn't closed, return the session to the idle sessions
+        if (!_closed) {
+            _idle.push_back(std::move(pooled_session));
+        } else {
+            _size--;
+        }
+    }
+
+    _cv.notify_one();
+
+    // Close the session if the pool was closed
+    if (pooled_session) {
+        try {
+            pooled_session->session.close();
+        } catch (...) {
+        }
+    }
+}
+
+void quesync::server::sql_pool::close() {
+    std::vector<std::unique_ptr<sql_pooled_session>> idle;
+
+    {
+        std::lock_guard lk(_mutex);
+
+        if (_closed) {
+            return;
+        }
+
+        _closed = true;
+
+        // Take all the idle sessions, the leased sessions are closed when they're released
+        idle.swap(_idle);
+        _size -= idle.size();
+    }
+
+    _reap_timer.cancel();
+    _stats_timer.cancel();
+
+    // Wake the threads waiting for a session
+    _cv.notify_all();
+
+    for (auto &session : idle) {
+        try {
+            session->session.close();
+        } catch (...) {
+        }
+    }
+
+    _client.close();
+}
+
+std::unique_ptr<quesync::server::sql_pooled_session> quesync::server::sql_pool::open_session() {
+    return std::unique_ptr<sql_pooled_session>(new sql_pooled_session{_client.getSession()});
+}
+
+void quesync::server::sql_pool::schedule_reap() {
+    _reap_timer.async_wait([this](std::error_code ec) {
+        if (ec) {
+            return;
+        }
+
+        reap();
+
+        _reap_timer.expires_at(_reap_timer.expiry() +
+                               std::chrono::milliseconds(SQL_POOL_REAP_INTERVAL_MS));
+        schedule_reap();
+    });
+}
+
+void quesync::server::sql_pool::reap() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<sql_pooled_session>> expired;
+
+    {
+        std::lock_guard lk(_mutex);
+
+        // The least recently released sessions are first, close them while they're idle for too
+        // long and the pool is above it's min size
+        while (!_idle.empty() && _size > _config.min_size &&
+               now - _idle.front()->released > std::chrono::seconds(_config.idle_timeout)) {
+            expired.push_back(std::move(_idle.front()));
+            _idle.erase(_idle.begin());
+            _size--;
+            _closed_sessions++;
+        }
+    }
+
+    // Wake a waiting thread since there is room for a new session
+    if (!expired.empty()) {
+        _cv.notify_one();
+    }
+
+    for (auto &session : expired) {
+        try {
+            session->session.close();
+        } catch (...) {
+        }
+    }
+}
+
+quesync::server::sql_pool_stats quesync::server::sql_pool::stats() {
+    std::lock_guard lk(_mutex);
+
+    uint64_t owned_leases = _leases - _shared_leases;
+
+    return sql_pool_stats{
+        _size,
+        _idle.size(),
+        _size - _idle.size(),
+        _waiting,
+        _leases,
+        _shared_leases,
+        _timeouts,
+        _opened,
+        _closed_sessions,
+        owned_leases
+            ? std::chrono::duration<double, std::milli>(_total_wait).count() / owned_leases
+            : 0,
+        owned_leases
+            ? std::chrono::duration<double, std::milli>(_total_hold).count() / owned_leases
+            : 0,
+        std::chrono::duration<double, std::milli>(_max_wait).count()};
+}
+
+void quesync::server::sql_pool::schedule_stats() {
+    _stats_timer.async_wait([this](std::error_code ec) {
+        if (ec) {
+            return;
+        }
+
+        print_stats();
+
+        _stats_timer.expires_at(_stats_timer.expiry() +
+                                std::chrono::seconds(_config.stats_interval));
+        schedule_stats();
+    });
+}
+
+void quesync::server::sql_pool::print_stats() {
+    sql_pool_stats stats = this->stats();
+
+    std::cout << termcolor::cyan << "SQL pool: " << stats.size << " sessions (" << stats.idle
+              << " idle, " << stats.leased << " leased), waiting " << stats.waiting << ", leases "
+              << stats.leases << " (" << stats.shared_leases << " shared), timeouts "
+              << stats.timeouts << ", opened " << stats.opened << ", closed " << stats.closed
+              << ", wait " << stats.average_wait << " ms (max " << stats.max_wait
+              << " ms), hold " << stats.average_hold << " ms" << termcolor::reset << "\n";
+}
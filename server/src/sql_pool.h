@@ -0,0 +1,212 @@
+#pragma once
+
+#include <asio.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <mysqlx/xdevapi.h>
+namespace sql = mysqlx;
+
+#define SQL_POOL_DEFAULT_MIN_SIZE 1
+#define SQL_POOL_DEFAULT_MAX_SIZE 16
+#define SQL_POOL_DEFAULT_IDLE_TIMEOUT 60
+#define SQL_POOL_DEFAULT_QUEUE_TIMEOUT 5000
+
+#define SQL_POOL_REAP_INTERVAL_MS 1000
+
+namespace quesync {
+namespace server {
+struct sql_pool_config {
+    /// The amount of sessions that are kept open even when idle.
+    unsigned int min_size = SQL_POOL_DEFAULT_MIN_SIZE;
+
+    /// The max amount of open sessions.
+    unsigned int max_size = SQL_POOL_DEFAULT_MAX_SIZE;
+
+    /// The time in seconds an idle session is kept open for, 0 for forever.
+    unsigned int idle_timeout = SQL_POOL_DEFAULT_IDLE_TIMEOUT;
+
+    /// The time in milliseconds to wait for a free session before failing.
+    unsigned int queue_timeout = SQL_POOL_DEFAULT_QUEUE_TIMEOUT;
+
+    /// The interval in seconds to print the statistics in, 0 for never.
+    unsigned int stats_interval = 0;
+};
+
+struct sql_pool_stats {
+    /// The amount of open, idle and leased sessions.
+    std::size_t size;
+    std::size_t idle;
+    std::size_t leased;
+
+    /// The amount of threads waiting for a free session.
+    std::size_t waiting;
+
+    /// The amount of leases and the amount of them that shared a session already leased.
+    uint64_t leases;
+    uint64_t shared_leases;
+
+    /// The amount of leases that failed since no session was freed in time.
+    uint64_t timeouts;
+
+    /// The amount of sessions opened and closed for being idle.
+    uint64_t opened;
+    uint64_t closed;
+
+    /// The average time a lease waited for a session and held it in milliseconds.
+    double average_wait;
+    double average_hold;
+
+    /// The max time a lease waited for a session in milliseconds.
+    double max_wait;
+};
+
+struct sql_pooled_session {
+    /// The SQL session.
+    sql::Session session;
+
+    /// The time the session was leased and the time it was released.
+    std::chrono::steady_clock::time_point leased;
+    std::chrono::steady_clock::time_point released;
+};
+
+class sql_pool;
+
+class sql_lease {
+   public:
+    /**
+     * SQL lease constructor.
+     *
+     * @param pool The pool the session belongs to.
+     * @param session The leased session.
+     * @param owner Is the lease the one that returns the session to the pool.
+     */
+    sql_lease(sql_pool *pool, sql_pooled_session *session, bool owner);
+    sql_lease(sql_lease &&other);
+    sql_lease(const sql_lease &) = delete;
+    ~sql_lease();
+
+    /**
+     * Gets the leased session.
+     *
+     * @return A pointer to the leased session.
+     */
+    sql::Session *operator->();
+
+    /**
+     * Gets the leased session.
+     *
+     * @return A reference to the leased session.
+     */
+    operator sql::Session &();
+
+   private:
+    /// The pool the session belongs to.
+    sql_pool *_pool;
+
+    /// The leased session.
+    sql_pooled_session *_session;
+
+    /// Is the lease the one that returns the session to the pool.
+    bool _owner;
+};
+
+class sql_request_scope {
+   public:
+    /**
+     * SQL request scope constructor. Until the scope ends, the first lease on the thread keeps
+     * it's session, so all the calls of a request share a single session.
+     */
+    sql_request_scope();
+    ~sql_request_scope();
+};
+
+class sql_pool {
+   public:
+    /**
+     * SQL pool constructor.
+     *
+     * @param uri The URI of the SQL server.
+     * @param config The sizing and timeouts of the pool.
+     * @param io_context The I/O context to run the pool's timers on.
+     */
+    sql_pool(std::string uri, sql_pool_config config, asio::io_context &io_context);
+    ~sql_pool();
+
+    /**
+     * Leases a session from the pool. While a thread holds a lease, any other lease on that
+     * thread shares it's session. Inside a request scope, the session is kept until the scope
+     * ends.
+     *
+     * @return The lease of the session, the session returns to the pool when it's destroyed.
+     */
+    sql_lease lease();
+
+    /**
+     * Closes all the sessions of the pool.
+     */
+    void close();
+
+    /**
+     * Get the statistics of the pool.
+     *
+     * @return The statistics of the pool.
+     */
+    sql_pool_stats stats();
+
+   private:
+    friend class sql_lease;
+
+    /// The SQL client used to open the sessions.
+    sql::Client _client;
+
+    /// The sizing and timeouts of the pool.
+    sql_pool_config _config;
+
+    /// The idle sessions, the most recently released is the last.
+    std::vector<std::unique_ptr<sql_pooled_session>> _idle;
+
+    /// The amount of open sessions.
+    std::size_t _size;
+
+    /// The amount of threads waiting for a free session.
+    std::size_t _waiting;
+
+    /// Was the pool closed.
+    bool _closed;
+
+    /// The counters of the pool.
+    uint64_t _leases;
+    uint64_t _shared_leases;
+    uint64_t _timeouts;
+    uint64_t _opened;
+    uint64_t _closed_sessions;
+    std::chrono::steady_clock::duration _total_wait;
+    std::chrono::steady_clock::duration _max_wait;
+    std::chrono::steady_clock::duration _total_hold;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+
+    /// The timer that closes the sessions that were idle for too long.
+    asio::steady_timer _reap_timer;
+
+    /// The timer that prints the statistics.
+    asio::steady_timer _stats_timer;
+
+    std::unique_ptr<sql_pooled_session> open_session();
+    void release(sql_pooled_session *session);
+
+    void schedule_reap();
+    void reap();
+
+    void schedule_stats();
+    void print_stats();
+};
+};  // namespace server
+};  // namespace quesync
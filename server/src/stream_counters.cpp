@@ -0,0 +1,89 @@
+#include "stream_counters.h"
+
+#include <cstdlib>
+
+quesync::server::stream_counters::stream_counters()
+    : _packets_in(0),
+      _bytes_in(0),
+      _packets_out(0),
+      _bytes_out(0),
+      _lost(0),
+      _reordered(0),
+      _started(false),
+      _highest_sequence(0),
+      _jitter(0),
+      _last_transit(0),
+      _relayed_packets(0),
+      _relay_time(0),
+      _epoch(std::chrono::steady_clock::now()) {}
+
+void quesync::server::stream_counters::received(const packets::voice_packet &packet,
+                                                std::size_t bytes) {
+    int64_t arrival = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - _epoch)
+                          .count() *
+                      COUNTERS_FREQUENCY / 1000000;
+    int64_t transit = arrival - packet.timestamp();
+    int16_t delta = 0;
+
+    std::lock_guard lk(_mutex);
+
+    _packets_in++;
+    _bytes_in += bytes;
+
+    // Count the skipped sequence numbers as lost until they arrive late
+    if (!_started) {
+        _highest_sequence = packet.sequence();
+        _started = true;
+    } else {
+        delta = (int16_t)(packet.sequence() - _highest_sequence);
+        if (delta > 0) {
+            _lost += delta - 1;
+            _highest_sequence = packet.sequence();
+        } else if (delta < 0) {
+            _reordered++;
+            if (_lost) {
+                _lost--;
+            }
+        }
+    }
+
+    // Estimate the inter-arrival jitter as described in RFC 3550
+    if (_last_transit) {
+        _jitter += (std::abs(transit - _last_transit) - _jitter) / COUNTERS_JITTER_SMOOTHING;
+    }
+    _last_transit = transit;
+}
+
+void quesync::server::stream_counters::forwarded(std::size_t bytes) {
+    std::lock_guard lk(_mutex);
+
+    _packets_out++;
+    _bytes_out += bytes;
+}
+
+void quesync::server::stream_counters::relayed(std::chrono::steady_clock::duration latency) {
+    std::lock_guard lk(_mutex);
+
+    _relayed_packets++;
+    _relay_time += std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+}
+
+quesync::voice::stream_stats quesync::server::stream_counters::stats() {
+    quesync::voice::stream_stats stats;
+
+    std::lock_guard lk(_mutex);
+
+    stats.packets_in = _packets_in;
+    stats.bytes_in = _bytes_in;
+    stats.packets_out = _packets_out;
+    stats.bytes_out = _bytes_out;
+    stats.lost = _lost;
+    stats.reordered = _reordered;
+    stats.jitter = _jitter * 1000 / COUNTERS_FREQUENCY;
+    if (_relayed_packets) {
+        stats.relay_latency = _relay_time / 1000.0 / _relayed_packets;
+    }
+
+    return stats;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include "../../shared/packets/voice_packet.h"
+#include "../../shared/voice_stats.h"
+
+#define COUNTERS_FREQUENCY 48000
+#define COUNTERS_JITTER_SMOOTHING 16
+
+namespace quesync {
+namespace server {
+class stream_counters {
+   public:
+    /**
+     * Stream counters constructor.
+     */
+    stream_counters();
+
+    /**
+     * Counts a voice packet received from the owner of the stream.
+     *
+     * @param packet The voice packet.
+     * @param bytes The size of the encrypted packet.
+     */
+    void received(const packets::voice_packet &packet, std::size_t bytes);
+
+    /**
+     * Counts a copy of the stream's voice sent to a participant.
+     *
+     * @param bytes The size of the encrypted packet.
+     */
+    void forwarded(std::size_t bytes);
+
+    /**
+     * Counts the time it took to relay a voice packet to all participants.
+     *
+     * @param latency The time from receiving the packet to sending the last copy of it.
+     */
+    void relayed(std::chrono::steady_clock::duration latency);
+
+    /**
+     * Get the statistics of the stream.
+     *
+     * @return The counters of the stream, the stream and user ids are left for the caller.
+     */
+    quesync::voice::stream_stats stats();
+
+   private:
+    /// The amount of packets and bytes received.
+    uint64_t _packets_in;
+    uint64_t _bytes_in;
+
+    /// The amount of packets and bytes forwarded.
+    uint64_t _packets_out;
+    uint64_t _bytes_out;
+
+    /// The amount of packets that were skipped by the sequence numbers and never arrived.
+    uint64_t _lost;
+
+    /// The amount of packets that arrived after a later packet.
+    uint64_t _reordered;
+
+    /// Did the stream receive any packet yet.
+    bool _started;
+
+    /// The highest sequence number received.
+    uint16_t _highest_sequence;
+
+    /// The estimated inter-arrival jitter of the stream in samples.
+    double _jitter;
+
+    /// The difference between the arrival time and the timestamp of the last packet in samples.
+    int64_t _last_transit;
+
+    /// The amount of relayed packets and the total time it took to relay them in nanoseconds.
+    uint64_t _relayed_packets;
+    uint64_t _relay_time;
+
+    /// The time the counters were created, the arrival times are relative to it.
+    std::chrono::steady_clock::time_point _epoch;
+
+    std::mutex _mutex;
+};
+};  // namespace server
+};  // namespace quesync
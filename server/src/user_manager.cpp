@@ -19,7 +19,7 @@ quesync::server::user_manager::user_manager(std::shared_ptr<quesync::server::ser
     : manager(server) {}
 
 bool quesync::server::user_manager::does_user_exists(std::string user_id) {
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table users_table(_server->get_sql_schema(sql_sess), "users");
 
     try {
@@ -34,7 +34,7 @@ std::shared_ptr<quesync::user> quesync::server::user_manager::authenticate_user(
     std::shared_ptr<quesync::server::session> sess, std::string username, std::string password) {
     std::shared_ptr<user> user = nullptr;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table users_table(_server->get_sql_schema(sql_sess), "users");
     sql::Row user_res;
 
@@ -89,7 +89,7 @@ std::shared_ptr<quesync::user> quesync::server::user_manager::register_user(
     std::string id, password_hashed;
     int tag;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table users_table(_server->get_sql_schema(sql_sess), "users");
     sql::Row user_res;
 
@@ -180,7 +180,7 @@ std::shared_ptr<quesync::profile> quesync::server::user_manager::get_user_profil
     std::string user_id) {
     std::shared_ptr<profile> profile = nullptr;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table profiles_table(_server->get_sql_schema(sql_sess), "profiles");
     sql::Row profile_res;
 
@@ -297,7 +297,7 @@ void quesync::server::user_manager::send_friend_request(std::string requester_id
     std::shared_ptr<events::friend_request_event> friend_request_event(
         std::make_shared<events::friend_request_event>(requester_id, std::time(nullptr)));
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table friendships_table(_server->get_sql_schema(sql_sess), "friendships");
 
     // Check if the recipient exists
@@ -343,7 +343,7 @@ void quesync::server::user_manager::set_friendship_status(std::string user_id,
     std::string requester, recipient;
     bool approved = false;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table friendships_table(_server->get_sql_schema(sql_sess), "friendships");
     sql::Row friendship_row;
 
@@ -435,7 +435,7 @@ void quesync::server::user_manager::set_profile_photo(
     std::shared_ptr<quesync::server::session> sess, std::string file_id) {
     std::shared_ptr<file> photo_file;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table users_table(_server->get_sql_schema(sql_sess), "users");
 
     // Check if the session is authenticated
@@ -483,7 +483,7 @@ std::vector<quesync::profile> quesync::server::user_manager::search(
     std::string nicknameInitial = nickname;
     std::string nicknameEnd = nickname;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     std::vector<sql::Row> res;
 
     // Insert % before and after the string to match any string containing the nickname
@@ -501,7 +501,7 @@ std::vector<quesync::profile> quesync::server::user_manager::search(
         if (tag != -1) {
             // Get all users matching the searched nickname and tag
             res = sql_sess
-                      .sql(
+                      ->sql(
                           "SELECT * FROM quesync.profiles WHERE nickname LIKE ? AND "
                           "tag = ? AND id != ? ORDER BY CASE WHEN nickname LIKE ? THEN 0 WHEN "
                           "nickname LIKE ? THEN 1 ELSE 2 END")
@@ -515,7 +515,7 @@ std::vector<quesync::profile> quesync::server::user_manager::search(
         } else {
             // Get all users matching the searched nickname
             res = sql_sess
-                      .sql(
+                      ->sql(
                           "SELECT * FROM quesync.profiles WHERE nickname LIKE ? AND "
                           "id != ? ORDER BY CASE WHEN nickname LIKE ? THEN 0 WHEN nickname LIKE ? "
                           "THEN 1 ELSE 2 END")
@@ -547,7 +547,7 @@ std::shared_ptr<quesync::user> quesync::server::user_manager::authenticate_user_
     std::shared_ptr<user> user = nullptr;
     std::string user_id;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table users_table(_server->get_sql_schema(sql_sess), "users");
     sql::Row user_res;
 
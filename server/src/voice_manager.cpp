@@ -1,153 +1,915 @@
 #include "voice_manager.h"
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
 #include <sole.hpp>
+#include <termcolor/termcolor.hpp>
 
 #include "server.h"
 #include "session.h"
 
 #include "../../shared/events/call_ended_event.h"
+#include "../../shared/events/voice_group_key_event.h"
 #include "../../shared/events/voice_state_event.h"
 #include "../../shared/exception.h"
 #include "../../shared/packets/voice_otp_packet.h"
 #include "../../shared/packets/voice_packet.h"
-#include "../../shared/packets/voice_participant_packet.h"
+#include "../../shared/packets/voice_report_packet.h"
 #include "../../shared/utils/encryption.h"
-#include "../../shared/utils/memory.h"
 #include "../../shared/utils/rand.h"
+#include "../../shared/utils/socket_options.h"
 
-quesync::server::voice_manager::voice_manager(std::shared_ptr<quesync::server::server> server)
+/// The send buffers that finished sending, reused by the next datagrams of the thread.
+static thread_local std::vector<std::shared_ptr<std::string>> free_buffers;
+
+quesync::server::voice_manager::voice_manager(std::shared_ptr<quesync::server::server> server,
+                                              unsigned int ingress_sockets, bool batch_io,
+                                              unsigned int max_speakers,
+                                              unsigned int mix_threshold,
+                                              unsigned int stats_interval)
     : manager(server),
-      _socket(server->get_io_context(), udp::endpoint(udp::v4(), VOICE_SERVER_PORT)),
-      _voice_states_thread(&voice_manager::handle_voice_states, this) {
-    // Detach voice states thread
-    _voice_states_thread.detach();
+      _max_speakers(max_speakers),
+      _mix_threshold(mix_threshold),
+      _mixed_channels(std::make_shared<const std::vector<std::shared_ptr<voice::fanout>>>()),
+      _mix_timer(server->get_io_context()),
+      _next_stream_id(1),
+      _pending_timer(server->get_io_context()),
+      _stats_interval(stats_interval),
+      _stats_timer(server->get_io_context()) {
+    // Init the routing table shards
+    for (auto &shard : _routes) {
+        shard = std::make_shared<const voice::routing_shard>();
+    }
+
+    // Open the voice sockets
+    open_ingress(ingress_sockets);
 
     // Start receiving
-    recv();
+    for (auto &ingress : _ingress) {
+#ifdef __linux__
+        if (batch_io) {
+            ingress->io_batch = std::make_unique<voice::batch>();
+            recv_batch(*ingress);
+
+            continue;
+        }
+#endif
+
+        recv(*ingress);
+    }
+
+    // Start the mixing ticks
+    if (_mix_threshold) {
+        _mix_timer.expires_after(std::chrono::milliseconds(MIX_INTERVAL_MS));
+        schedule_mix();
+    }
+
+    // Start printing the statistics of the streams
+    if (_stats_interval) {
+        _stats_timer.expires_after(std::chrono::seconds(_stats_interval));
+        schedule_stats();
+    }
+
+    // Run each dedicated I/O context in it's own thread
+    for (auto &io_context : _ingress_contexts) {
+        _ingress_threads.push_back(std::thread([io_context = io_context.get()] {
+            while (!io_context->stopped()) {
+                try {
+                    io_context->run();
+                } catch (...) {
+                }
+            }
+        }));
+    }
+}
+
+quesync::server::voice_manager::~voice_manager() {
+    // Stop the mixing ticks, the expiry of the pending states and the statistics printing
+    _mix_timer.cancel();
+    _pending_timer.cancel();
+    _stats_timer.cancel();
+
+    // Stop the dedicated I/O contexts and wait for their threads
+    for (auto &io_context : _ingress_contexts) {
+        io_context->stop();
+    }
+    for (auto &thread : _ingress_threads) {
+        if (thread.joinable()) thread.join();
+    }
+}
+
+void quesync::server::voice_manager::open_ingress(unsigned int ingress_sockets) {
+#ifndef SO_REUSEPORT
+    // Multiple sockets on the same port are only supported with SO_REUSEPORT
+    ingress_sockets = 1;
+#endif
+
+    // A single socket is handled by the server's I/O context
+    if (ingress_sockets <= 1) {
+        _ingress.push_back(std::make_unique<voice::ingress>(_server->get_io_context()));
+        _ingress.back()->socket.open(udp::v4());
+        _ingress.back()->socket.bind(udp::endpoint(udp::v4(), VOICE_SERVER_PORT));
+
+        return;
+    }
+
+#ifdef SO_REUSEPORT
+    // Open each socket with it's own I/O context and bind all of them to the voice port
+    for (unsigned int i = 0; i < ingress_sockets; i++) {
+        _ingress_contexts.push_back(std::make_unique<asio::io_context>(1));
+        _ingress.push_back(std::make_unique<voice::ingress>(*_ingress_contexts.back()));
+
+        _ingress.back()->socket.open(udp::v4());
+        _ingress.back()->socket.set_option(utils::reuse_port(true));
+        _ingress.back()->socket.bind(udp::endpoint(udp::v4(), VOICE_SERVER_PORT));
+    }
+#endif
 }
 
-void quesync::server::voice_manager::recv() {
-    _socket.async_receive_from(asio::buffer(_buf, MAX_DATA_LEN), _sender_endpoint,
-                               [this](std::error_code ec, std::size_t bytes) {
-                                   if (!ec && bytes > 0) {
-                                       handle_packet(bytes);
-                                   }
+void quesync::server::voice_manager::recv(voice::ingress &ingress) {
+    ingress.socket.async_receive_from(
+        asio::buffer(ingress.buf, MAX_DATA_LEN), ingress.sender_endpoint,
+        ingress.strand.wrap([this, &ingress](std::error_code ec, std::size_t bytes) {
+            // The copy of the packet is reused between packets of the same thread
+            thread_local std::string data;
+            udp::endpoint sender_endpoint = ingress.sender_endpoint;
+            bool received = !ec && bytes > 0;
+
+            // Copy the packet out of the receive buffer
+            if (received) {
+                data.assign(ingress.buf, bytes);
+            }
+
+            // Receive the next packet, it's handled on the strand after this one
+            recv(ingress);
 
-                                   recv();
-                               });
+            if (received) {
+                handle_packet(ingress, data, sender_endpoint);
+            }
+        }));
 }
 
-void quesync::server::voice_manager::send(std::shared_ptr<char> buf, size_t length,
-                                          udp::endpoint endpoint) {
-    _socket.async_send_to(asio::buffer(buf.get(), length), endpoint,
-                          [this, buf](std::error_code, std::size_t) {});
+#ifdef __linux__
+void quesync::server::voice_manager::recv_batch(voice::ingress &ingress) {
+    // Wait for the socket to be readable and drain it in batches
+    ingress.socket.async_wait(udp::socket::wait_read,
+                              ingress.strand.wrap([this, &ingress](std::error_code ec) {
+                                  if (!ec) {
+                                      handle_batch(ingress);
+                                  }
+
+                                  recv_batch(ingress);
+                              }));
 }
 
-void quesync::server::voice_manager::handle_packet(std::size_t length) {
-    packets::voice_otp_packet otp_packet;
+void quesync::server::voice_manager::handle_batch(voice::ingress &ingress) {
+    voice::batch &batch = *ingress.io_batch;
+    udp::endpoint sender_endpoint;
+    int received = 0;
+
+    // The copy of the packet is reused between packets of the same thread
+    thread_local std::string data;
 
-    voice::encryption_info encryption_info;
-    std::string user_session;
-    std::shared_ptr<packets::voice_packet> packet;
+    do {
+        // Reset the headers since the kernel overwrites the length of the address
+        for (int i = 0; i < VOICE_BATCH_SIZE; i++) {
+            batch.recv_iovecs[i] = iovec{batch.bufs[i], MAX_DATA_LEN};
 
-    voice::encryption_info participant_encryption_info;
-    std::string participant_session;
-    udp::endpoint participant_endpoint;
+            batch.recv_msgs[i] = mmsghdr{};
+            batch.recv_msgs[i].msg_hdr.msg_name = &batch.addrs[i];
+            batch.recv_msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+            batch.recv_msgs[i].msg_hdr.msg_iov = &batch.recv_iovecs[i];
+            batch.recv_msgs[i].msg_hdr.msg_iovlen = 1;
+        }
 
-    packets::voice_participant_packet participant_packet;
-    std::string participant_packet_encrypted;
-    std::shared_ptr<char> buf;
+        // Receive all the datagrams that are waiting in the socket
+        received = recvmmsg(ingress.socket.native_handle(), batch.recv_msgs, VOICE_BATCH_SIZE,
+                            MSG_DONTWAIT, nullptr);
 
-    std::unordered_map<std::string, voice::state> voice_states;
+        // Handle each datagram, the fan-out copies are queued in the batch
+        for (int i = 0; i < received; i++) {
+            if (!batch.recv_msgs[i].msg_len) {
+                continue;
+            }
 
-    std::lock_guard lk(_mutex);
+            // Get the endpoint of the sender
+            memcpy(sender_endpoint.data(), &batch.addrs[i],
+                   batch.recv_msgs[i].msg_hdr.msg_namelen);
+            sender_endpoint.resize(batch.recv_msgs[i].msg_hdr.msg_namelen);
+
+            data.assign(batch.bufs[i], batch.recv_msgs[i].msg_len);
+            handle_packet(ingress, data, sender_endpoint);
+        }
+
+        // Send all the fan-out copies of the received datagrams
+        flush_batch(ingress);
+    } while (received == VOICE_BATCH_SIZE);
+}
+
+void quesync::server::voice_manager::flush_batch(voice::ingress &ingress) {
+    voice::batch &batch = *ingress.io_batch;
+    int amount = 0, sent = 0, res = 0;
+
+    for (std::size_t offset = 0; offset < batch.pending.size(); offset += VOICE_BATCH_SIZE) {
+        amount = (int)std::min<std::size_t>(VOICE_BATCH_SIZE, batch.pending.size() - offset);
 
-    // If the packet is an OTP packet
-    if (otp_packet.decode(std::string(_buf, length))) {
-        try {
-            // Get user's session
-            user_session = _otps[otp_packet.otp()];
+        // Format the headers of the datagrams
+        for (int i = 0; i < amount; i++) {
+            voice::datagram &datagram = batch.pending[offset + i];
 
-            // Save endpoint
-            _session_endpoints[user_session] = _sender_endpoint;
+            batch.send_iovecs[i] = iovec{(void *)datagram.data->data(), datagram.data->length()};
 
-            // Remove OTP
-            _otps.erase(otp_packet.otp());
-        } catch (...) {
+            batch.send_msgs[i] = mmsghdr{};
+            batch.send_msgs[i].msg_hdr.msg_name = datagram.endpoint.data();
+            batch.send_msgs[i].msg_hdr.msg_namelen = (socklen_t)datagram.endpoint.size();
+            batch.send_msgs[i].msg_hdr.msg_iov = &batch.send_iovecs[i];
+            batch.send_msgs[i].msg_hdr.msg_iovlen = 1;
         }
 
+        // Send the datagrams, skip a datagram that failed and drop the rest if the socket's
+        // buffer is full since late voice is useless
+        for (sent = 0; sent < amount;) {
+            res = sendmmsg(ingress.socket.native_handle(), batch.send_msgs + sent, amount - sent,
+                           MSG_DONTWAIT);
+            if (res > 0) {
+                sent += res;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else {
+                sent++;
+            }
+        }
+    }
+
+    // Reuse the buffers of the sent datagrams
+    for (auto &datagram : batch.pending) {
+        release_buffer(std::move(datagram.data));
+    }
+    batch.pending.clear();
+}
+#endif
+
+void quesync::server::voice_manager::send(voice::ingress &ingress,
+                                          std::shared_ptr<std::string> buf,
+                                          const udp::endpoint &endpoint) {
+    // Must be called on the strand of the ingress, since the socket and it's batch belong to it
+#ifdef __linux__
+    // Queue the datagram for the next batch flush
+    if (ingress.io_batch) {
+        ingress.io_batch->pending.push_back(voice::datagram{buf, endpoint});
         return;
     }
+#endif
 
-    // Try to find the participant session by his endpoint and get it's
-    // encryption info
-    try {
-        user_session = std::find_if(_session_endpoints.begin(), _session_endpoints.end(),
-                                    [this](const std::pair<std::string, udp::endpoint>& p) {
-                                        return p.second == _sender_endpoint;
-                                    })
-                           ->first;
+    ingress.socket.async_send_to(
+        asio::buffer(buf->data(), buf->length()), endpoint,
+        [this, buf](std::error_code, std::size_t) mutable { release_buffer(std::move(buf)); });
+}
 
-        encryption_info = _session_keys.at(user_session);
-    } catch (...) {
+std::shared_ptr<std::string> quesync::server::voice_manager::acquire_buffer() {
+    std::shared_ptr<std::string> buf;
+
+    // If there is no free buffer, allocate a new one
+    if (free_buffers.empty()) {
+        return std::make_shared<std::string>();
+    }
+
+    buf = std::move(free_buffers.back());
+    free_buffers.pop_back();
+
+    return buf;
+}
+
+void quesync::server::voice_manager::release_buffer(std::shared_ptr<std::string> buf) {
+    // Keep the buffer only if no other datagram still uses it
+    if (buf && buf.use_count() == 1 && free_buffers.size() < VOICE_MAX_FREE_BUFFERS) {
+        free_buffers.push_back(std::move(buf));
+    }
+}
+
+void quesync::server::voice_manager::handle_packet(voice::ingress &ingress,
+                                                   const std::string &data,
+                                                   const udp::endpoint &sender_endpoint) {
+    std::chrono::steady_clock::time_point received = std::chrono::steady_clock::now();
+    packets::voice_otp_packet otp_packet;
+
+    // The decoded and encoded packets are reused between packets of the same thread
+    thread_local packets::voice_packet packet;
+    thread_local std::string packet_encoded;
+
+    std::shared_ptr<const voice::route> route;
+    std::shared_ptr<const voice::group_key> group;
+    std::shared_ptr<packets::voice_packet> cbc_packet;
+    std::shared_ptr<voice_mixer> mixer;
+    bool decrypted = false;
+
+    std::shared_ptr<const std::vector<voice::participant>> participants;
+    std::shared_ptr<std::string> packet_encrypted;
+
+    // If the packet is an OTP packet, redeem it
+    if (otp_packet.decode(data)) {
+        redeem_otp(otp_packet.otp(), sender_endpoint);
+        return;
+    }
+
+    // Try to find the route of the sender by his endpoint
+    route = find_route(sender_endpoint);
+    if (!route) {
         return;
     }
 
+    // If the user's channel uses a group key, verify the packet once and forward it as is
+    if (route->channel) {
+        group = std::atomic_load(&route->channel->group);
+        if (group && relay_group_packet(ingress, data, sender_endpoint, route, group, received)) {
+            return;
+        }
+    }
+
     // Try to decrypt the voice packet
-    packet = utils::encryption::decrypt_voice_packet<packets::voice_packet>(
-        std::string(_buf, length), encryption_info.aes_key.get(), encryption_info.hmac_key.get());
-    if (!packet) {
+    if (route->keys.aead) {
+        decrypted = utils::encryption::decrypt_voice_packet(data.data(), data.length(),
+                                                            route->keys.aead.get(), packet);
+    } else {
+        cbc_packet = utils::encryption::decrypt_voice_packet<packets::voice_packet>(
+            data, route->keys.aes_key.get(), route->keys.hmac_key.get());
+        if (cbc_packet) {
+            packet = std::move(*cbc_packet);
+            decrypted = true;
+        }
+    }
+    if (!decrypted) {
+        // Reports are sent with the session keys even when the channel uses a group key
+        relay_report(ingress, data, sender_endpoint, route);
         return;
     }
 
-    // Try to find the channel participants
-    try {
-        voice_states = _voice_channels.at(packet->channel_id())->voice_states;
-    } catch (...) {
+    // If the user isn't joined to a channel or the packet isn't of the user's stream
+    if (!route->channel || group || route->stream_id != packet.stream_id()) {
         return;
     }
 
-    // If the user isn't a part of the channel
-    if (!voice_states.count(packet->user_id())) {
+    route->counters->received(packet, data.length());
+
+    // If the user isn't one of the loudest speakers of the channel, drop it's voice
+    if (!select_speaker(*route->channel, packet.stream_id(), packet.level())) {
         return;
     }
 
-    if (packet->voice_data_len()) {
-        // Create the pariticipant voice packet and encode it
-        participant_packet = packets::voice_participant_packet(
-            packet->user_id(), packet->voice_data(), packet->voice_data_len());
+    // If the channel is mixed, the voice is sent with the next mixing tick
+    mixer = std::atomic_load(&route->channel->mixer);
+    if (mixer) {
+        if (packet.voice_data_len()) {
+            mixer->push(packet);
+        }
 
-        // Send the participant voice packet to all other participants
-        for (auto& participant : voice_states) {
+        return;
+    }
+
+    // Get the current participants of the channel
+    participants = std::atomic_load(&route->channel->participants);
+    if (!participants) {
+        return;
+    }
+
+    if (packet.voice_data_len()) {
+        // The packet is forwarded as is, only the encryption differs for each participant
+        packet.encode(packet_encoded);
+
+        // Send the voice packet to all other participants
+        for (auto &participant : *participants) {
             // If the given participant isn't our user
-            if (participant.first != packet->user_id()) {
-                try {
-                    // Try to get the session, key and endpoint of the
-                    // participant
-                    participant_session = _sessions.at(participant.first);
-                    participant_endpoint = _session_endpoints.at(participant_session);
-                    participant_encryption_info = _session_keys.at(participant_session);
-                } catch (...) {
-                    continue;
+            if (participant.endpoint != sender_endpoint) {
+                // Encrypt the packet for the participant into a reused buffer
+                packet_encrypted = acquire_buffer();
+                if (participant.keys.aead) {
+                    if (!utils::encryption::encrypt_voice_data(
+                            packet_encoded.data(), packet_encoded.length(),
+                            participant.keys.aead.get(), *packet_encrypted)) {
+                        packet_encrypted->clear();
+                    }
+                } else {
+                    *packet_encrypted =
+                        utils::encryption::encrypt_voice_packet<packets::voice_packet>(
+                            &packet, participant.keys.aes_key.get(),
+                            participant.keys.hmac_key.get());
+                }
+
+                // Send the voice packet to the participant
+                if (!packet_encrypted->empty()) {
+                    send(ingress, packet_encrypted, participant.endpoint);
+                    route->counters->forwarded(packet_encrypted->length());
                 }
+            }
+        }
 
-                // Encrypt the packet and convert it to buffer
-                participant_packet_encrypted =
-                    utils::encryption::encrypt_voice_packet<packets::voice_participant_packet>(
-                        &participant_packet, participant_encryption_info.aes_key.get(),
-                        participant_encryption_info.hmac_key.get());
-                buf = utils::memory::convert_to_buffer<char>(participant_packet_encrypted);
+        route->counters->relayed(std::chrono::steady_clock::now() - received);
+    }
+}
+
+bool quesync::server::voice_manager::select_speaker(voice::fanout &channel, uint32_t stream_id,
+                                                    uint8_t level) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::milliseconds timeout(SPEAKER_TIMEOUT_MS);
+    unsigned int louder = 0;
+    float current_level = 0, other_level = 0;
+
+    // If there is no limit, forward all speakers
+    if (!_max_speakers) {
+        return true;
+    }
+
+    std::lock_guard lk(channel.speakers_mutex);
+
+    // Smooth the level of the speaker so a short peak doesn't take over a slot
+    auto current = channel.speakers.find(stream_id);
+    if (current == channel.speakers.end() || now - current->second.last_packet > timeout) {
+        current = channel.speakers.insert_or_assign(stream_id, voice::speaker{level, false, now})
+                      .first;
+    } else {
+        current->second.level += (level - current->second.level) * SPEAKER_LEVEL_SMOOTHING;
+        current->second.last_packet = now;
+    }
+
+    // Forwarded speakers keep their slot until another speaker is clearly louder
+    current_level = current->second.level - (current->second.forwarded ? SPEAKER_HYSTERESIS : 0);
+
+    // Count the active speakers that are louder than the speaker and remove the inactive ones
+    for (auto it = channel.speakers.begin(); it != channel.speakers.end();) {
+        if (now - it->second.last_packet > timeout) {
+            it = channel.speakers.erase(it);
+            continue;
+        }
+
+        other_level = it->second.level - (it->second.forwarded ? SPEAKER_HYSTERESIS : 0);
+        if (it->first != stream_id && other_level < current_level) {
+            louder++;
+        }
+
+        it++;
+    }
+
+    current->second.forwarded = louder < _max_speakers;
+
+    return current->second.forwarded;
+}
+
+bool quesync::server::voice_manager::relay_group_packet(
+    voice::ingress &ingress, const std::string &data, const udp::endpoint &sender_endpoint,
+    std::shared_ptr<const voice::route> route, std::shared_ptr<const voice::group_key> group,
+    std::chrono::steady_clock::time_point received) {
+    // The decoded packet is reused between packets of the same thread
+    thread_local packets::voice_packet packet;
+
+    std::shared_ptr<const std::vector<voice::participant>> participants;
+    std::shared_ptr<std::string> forwarded;
+
+    // The sender must encrypt with it's own nonce prefix so it can't replay the voice of others
+    if (data.length() <= sizeof(voice::group_header) ||
+        memcmp(((const voice::group_header *)data.data())->aead.nonce, &route->group_nonce_prefix,
+               sizeof(route->group_nonce_prefix)) != 0) {
+        return false;
+    }
+
+    // Verify the packet with the current group key
+    if (!utils::encryption::decrypt_group_voice_packet(data, group->epoch, group->aead.get(),
+                                                       packet)) {
+        return false;
+    }
+
+    // Drop voice that isn't of the user's stream
+    if (packet.stream_id() != route->stream_id || !packet.voice_data_len()) {
+        return true;
+    }
+
+    route->counters->received(packet, data.length());
+
+    // If the user isn't one of the loudest speakers of the channel, drop it's voice
+    if (!select_speaker(*route->channel, packet.stream_id(), packet.level())) {
+        return true;
+    }
+
+    // Get the current participants of the channel
+    participants = std::atomic_load(&route->channel->participants);
+    if (!participants) {
+        return true;
+    }
+
+    // Forward the same encrypted packet to all other participants
+    forwarded = acquire_buffer();
+    forwarded->assign(data);
+    for (auto &participant : *participants) {
+        if (participant.endpoint != sender_endpoint) {
+            send(ingress, forwarded, participant.endpoint);
+            route->counters->forwarded(forwarded->length());
+        }
+    }
+
+    route->counters->relayed(std::chrono::steady_clock::now() - received);
+
+    return true;
+}
+
+void quesync::server::voice_manager::relay_report(voice::ingress &ingress,
+                                                  const std::string &data,
+                                                  const udp::endpoint &sender_endpoint,
+                                                  std::shared_ptr<const voice::route> route) {
+    std::shared_ptr<packets::voice_report_packet> report;
+    std::shared_ptr<const std::vector<voice::participant>> participants;
+    std::shared_ptr<std::string> report_encrypted;
+
+    // Try to decrypt the report
+    if (route->keys.aead) {
+        report = utils::encryption::decrypt_voice_packet<packets::voice_report_packet>(
+            data, route->keys.aead.get());
+    } else {
+        report = utils::encryption::decrypt_voice_packet<packets::voice_report_packet>(
+            data, route->keys.aes_key.get(), route->keys.hmac_key.get());
+    }
+    if (!report || !route->channel) {
+        return;
+    }
+
+    // Echo the report back to the reporter so it can measure it's RTT to the server, it's sealed
+    // again since the reporter doesn't open packets sealed with it's own nonce prefix
+    if (route->keys.aead) {
+        report_encrypted = std::make_shared<std::string>(
+            utils::encryption::encrypt_voice_packet<packets::voice_report_packet>(
+                report.get(), route->keys.aead.get()));
+    } else {
+        report_encrypted = std::make_shared<std::string>(
+            utils::encryption::encrypt_voice_packet<packets::voice_report_packet>(
+                report.get(), route->keys.aes_key.get(), route->keys.hmac_key.get()));
+    }
+    if (!report_encrypted->empty()) {
+        send(ingress, report_encrypted, sender_endpoint);
+    }
+
+    // Get the current participants of the channel
+    participants = std::atomic_load(&route->channel->participants);
+    if (!participants) {
+        return;
+    }
 
-                // Send the participant voice packet to the participant
-                send(buf, participant_packet_encrypted.length(), participant_endpoint);
+    // Forward the report to the sender of the reported stream
+    for (auto &participant : *participants) {
+        if (participant.stream_id == report->stream_id() &&
+            participant.endpoint != sender_endpoint) {
+            if (participant.keys.aead) {
+                report_encrypted = std::make_shared<std::string>(
+                    utils::encryption::encrypt_voice_packet<packets::voice_report_packet>(
+                        report.get(), participant.keys.aead.get()));
+            } else {
+                report_encrypted = std::make_shared<std::string>(
+                    utils::encryption::encrypt_voice_packet<packets::voice_report_packet>(
+                        report.get(), participant.keys.aes_key.get(),
+                        participant.keys.hmac_key.get()));
             }
+
+            if (!report_encrypted->empty()) {
+                send(ingress, report_encrypted, participant.endpoint);
+            }
+
+            break;
+        }
+    }
+}
+
+void quesync::server::voice_manager::redeem_otp(std::string otp,
+                                                const udp::endpoint &sender_endpoint) {
+    std::shared_ptr<const voice::route> previous_route;
+    std::string session_id;
+
+    std::lock_guard lk(_mutex);
+
+    // If the OTP doesn't exist, ignore it
+    auto otp_it = _otps.find(otp);
+    if (otp_it == _otps.end()) {
+        return;
+    }
+
+    // Get user's session and remove the OTP
+    session_id = otp_it->second;
+    _otps.erase(otp_it);
+
+    // If the session was deleted since the OTP was generated, ignore it
+    if (!_session_users.count(session_id)) {
+        return;
+    }
+
+    // Remove the previous route of the session
+    remove_route(session_id);
+
+    // If the endpoint was used by another session, remove the old session's endpoint
+    previous_route = find_route(sender_endpoint);
+    if (previous_route) {
+        _session_endpoints.erase(previous_route->session_id);
+        publish_route(sender_endpoint, nullptr);
+        rebuild_session_fanout(previous_route->session_id);
+    }
+
+    // Save endpoint and route it to the session
+    _session_endpoints[session_id] = sender_endpoint;
+    update_route(session_id);
+
+    // Add the new endpoint to the fan-out list of the session's channel
+    rebuild_session_fanout(session_id);
+}
+
+std::shared_ptr<const quesync::voice::route> quesync::server::voice_manager::find_route(
+    const udp::endpoint &endpoint) {
+    std::shared_ptr<const voice::routing_shard> shard =
+        std::atomic_load(&_routes[voice::endpoint_hash()(endpoint) % ROUTING_SHARDS]);
+
+    // Try to find the route of the endpoint in it's shard
+    auto route = shard->routes.find(endpoint);
+    if (route == shard->routes.end()) {
+        return nullptr;
+    }
+
+    return route->second;
+}
+
+void quesync::server::voice_manager::publish_route(const udp::endpoint &endpoint,
+                                                   std::shared_ptr<const voice::route> route) {
+    std::shared_ptr<const voice::routing_shard> &current_shard =
+        _routes[voice::endpoint_hash()(endpoint) % ROUTING_SHARDS];
+
+    // Copy the current snapshot of the shard
+    std::shared_ptr<voice::routing_shard> shard =
+        std::make_shared<voice::routing_shard>(*std::atomic_load(&current_shard));
+
+    // Set or remove the route of the endpoint
+    if (route) {
+        shard->routes[endpoint] = route;
+    } else {
+        shard->routes.erase(endpoint);
+    }
+
+    // Publish the new snapshot of the shard
+    std::atomic_store(&current_shard, std::shared_ptr<const voice::routing_shard>(shard));
+}
+
+void quesync::server::voice_manager::update_route(std::string session_id) {
+    std::string user_id, channel_id;
+    uint32_t group_nonce_prefix = 0;
+
+    // If the session has no endpoint yet, there is nothing to route
+    if (!_session_endpoints.count(session_id) || !_session_users.count(session_id)) {
+        return;
+    }
+    user_id = _session_users[session_id];
+
+    // Get the joined voice channel of the user
+    if (_joined_voice_channels.count(user_id)) {
+        channel_id = _joined_voice_channels[user_id];
+    }
+
+    // Get the group nonce prefix of the user
+    if (_group_nonce_prefixes.count(user_id)) {
+        group_nonce_prefix = _group_nonce_prefixes[user_id];
+    }
+
+    // Publish the route of the session's endpoint
+    publish_route(_session_endpoints[session_id],
+                  std::make_shared<const voice::route>(voice::route{
+                      session_id, user_id, _session_streams[session_id],
+                      _session_keys[session_id], channel_id,
+                      channel_id.empty() ? nullptr : _fanouts[channel_id], group_nonce_prefix,
+                      _session_counters[session_id]}));
+}
+
+void quesync::server::voice_manager::remove_route(std::string session_id) {
+    // If the session has no endpoint, it has no route
+    if (!_session_endpoints.count(session_id)) {
+        return;
+    }
+
+    publish_route(_session_endpoints[session_id], nullptr);
+}
+
+void quesync::server::voice_manager::rebuild_fanout(std::string channel_id) {
+    std::shared_ptr<voice::fanout> fanout;
+    std::shared_ptr<std::vector<voice::participant>> participants;
+    std::string session_id;
+    bool mixed = false;
+
+    // If the channel isn't active, it has no fan-out list
+    if (!_voice_channels.count(channel_id)) {
+        return;
+    }
+
+    // Create the fan-out list of the channel if it doesn't exist
+    fanout = _fanouts[channel_id];
+    if (!fanout) {
+        fanout = _fanouts[channel_id] = std::make_shared<voice::fanout>();
+    }
+
+    // Build a new list of the participants
+    participants = std::make_shared<std::vector<voice::participant>>();
+    for (auto &user : _voice_channels[channel_id]->voice_states) {
+        // Only connected users with an authenticated voice session get the channel's voice
+        if (user.second == voice::state_type::connected && _sessions.count(user.first)) {
+            session_id = _sessions[user.first];
+
+            if (_session_endpoints.count(session_id)) {
+                participants->push_back(voice::participant{
+                    user.first, _session_endpoints[session_id], _session_streams[session_id],
+                    _session_keys[session_id]});
+            }
+        }
+    }
+
+    // Publish the new list, the routes of the channel keep pointing to the same fan-out object
+    std::atomic_store(&fanout->participants,
+                      std::shared_ptr<const std::vector<voice::participant>>(participants));
+    std::atomic_store(&fanout->group, _group_keys.count(channel_id)
+                                          ? _group_keys[channel_id]
+                                          : std::shared_ptr<const voice::group_key>());
+
+    // Mix the channel if it's too big, the voice of group key channels can't be decoded
+    mixed = _mix_threshold && participants->size() >= _mix_threshold &&
+            !_group_keys.count(channel_id);
+    if (mixed != (bool)std::atomic_load(&fanout->mixer)) {
+        std::atomic_store(&fanout->mixer,
+                          mixed ? std::make_shared<voice_mixer>() : std::shared_ptr<voice_mixer>());
+        publish_mixed_channels();
+    }
+}
+
+void quesync::server::voice_manager::publish_mixed_channels() {
+    std::shared_ptr<std::vector<std::shared_ptr<voice::fanout>>> mixed_channels =
+        std::make_shared<std::vector<std::shared_ptr<voice::fanout>>>();
+
+    for (auto &fanout : _fanouts) {
+        if (fanout.second && std::atomic_load(&fanout.second->mixer)) {
+            mixed_channels->push_back(fanout.second);
+        }
+    }
+
+    std::atomic_store(
+        &_mixed_channels,
+        std::shared_ptr<const std::vector<std::shared_ptr<voice::fanout>>>(mixed_channels));
+}
+
+void quesync::server::voice_manager::schedule_mix() {
+    _mix_timer.async_wait([this](std::error_code ec) {
+        if (ec) {
+            return;
+        }
+
+        mix_channels();
+
+        // Keep a fixed rate of ticks regardless of the time the mixing took
+        _mix_timer.expires_at(_mix_timer.expiry() + std::chrono::milliseconds(MIX_INTERVAL_MS));
+        schedule_mix();
+    });
+}
+
+void quesync::server::voice_manager::mix_channels() {
+    std::shared_ptr<const std::vector<std::shared_ptr<voice::fanout>>> mixed_channels =
+        std::atomic_load(&_mixed_channels);
+
+    std::shared_ptr<voice_mixer> mixer;
+    std::shared_ptr<const std::vector<voice::participant>> participants;
+    std::vector<uint32_t> listeners;
+    std::unordered_map<uint32_t, std::shared_ptr<packets::voice_packet>> mixes;
+    std::shared_ptr<std::string> packet_encrypted;
+    std::vector<voice::datagram> datagrams;
+
+    for (auto &channel : *mixed_channels) {
+        mixer = std::atomic_load(&channel->mixer);
+        participants = std::atomic_load(&channel->participants);
+        if (!mixer || !participants) {
+            continue;
+        }
+
+        // Mix the channel for all of it's participants
+        listeners.clear();
+        for (auto &participant : *participants) {
+            listeners.push_back(participant.stream_id);
+        }
+        mixes = mixer->mix(listeners);
+
+        for (auto &participant : *participants) {
+            auto mix = mixes.find(participant.stream_id);
+            if (mix == mixes.end()) {
+                continue;
+            }
+
+            // Encrypt the mix for the participant
+            if (participant.keys.aead) {
+                packet_encrypted = std::make_shared<std::string>(
+                    utils::encryption::encrypt_voice_packet<packets::voice_packet>(
+                        mix->second.get(), participant.keys.aead.get()));
+            } else {
+                packet_encrypted = std::make_shared<std::string>(
+                    utils::encryption::encrypt_voice_packet<packets::voice_packet>(
+                        mix->second.get(), participant.keys.aes_key.get(),
+                        participant.keys.hmac_key.get()));
+            }
+
+            if (!packet_encrypted->empty()) {
+                datagrams.push_back(voice::datagram{packet_encrypted, participant.endpoint});
+            }
+        }
+    }
+
+    if (datagrams.empty()) {
+        return;
+    }
+
+    // Send the mixes on the strand of the ingress socket, since the socket and it's batch belong
+    // to it and it's I/O context might be run by several threads
+    voice::ingress &ingress = *_ingress.front();
+    asio::post(ingress.strand, [this, &ingress, datagrams = std::move(datagrams)] {
+        for (auto &datagram : datagrams) {
+            send(ingress, datagram.data, datagram.endpoint);
+        }
+
+#ifdef __linux__
+        if (ingress.io_batch) {
+            flush_batch(ingress);
+        }
+#endif
+    });
+}
+
+void quesync::server::voice_manager::schedule_stats() {
+    _stats_timer.async_wait([this](std::error_code ec) {
+        if (ec) {
+            return;
+        }
+
+        print_stats();
+
+        _stats_timer.expires_at(_stats_timer.expiry() + std::chrono::seconds(_stats_interval));
+        schedule_stats();
+    });
+}
+
+void quesync::server::voice_manager::print_stats() {
+    for (auto &stream : get_stream_stats()) {
+        std::cout << termcolor::cyan << "Voice stream " << stream.stream_id << " ("
+                  << stream.user_id << "): in " << stream.packets_in << " packets / "
+                  << stream.bytes_in << " bytes, out " << stream.packets_out << " packets / "
+                  << stream.bytes_out << " bytes, lost " << stream.lost << ", reordered "
+                  << stream.reordered << ", jitter " << stream.jitter << " ms, relay latency "
+                  << stream.relay_latency << " us" << termcolor::reset << "\n";
+    }
+}
+
+std::vector<quesync::voice::stream_stats> quesync::server::voice_manager::get_stream_stats() {
+    std::vector<quesync::voice::stream_stats> streams;
+
+    std::lock_guard lk(_mutex);
+
+    for (auto &counters : _session_counters) {
+        streams.push_back(counters.second->stats());
+        streams.back().stream_id = _session_streams[counters.first];
+        streams.back().user_id = _session_users[counters.first];
+    }
+
+    return streams;
+}
+
+void quesync::server::voice_manager::rebuild_session_fanout(std::string session_id) {
+    // If the session's user is joined to a voice channel, rebuild it's fan-out list
+    if (_session_users.count(session_id) &&
+        _joined_voice_channels.count(_session_users[session_id])) {
+        rebuild_fanout(_joined_voice_channels[_session_users[session_id]]);
+    }
+}
+
+void quesync::server::voice_manager::rotate_group_key(std::string channel_id) {
+    std::shared_ptr<voice::group_key> group = std::make_shared<voice::group_key>();
+    std::shared_ptr<events::voice_group_key_event> group_key_event;
+
+    // Generate the key of the next epoch
+    group->epoch = _group_keys.count(channel_id) ? _group_keys[channel_id]->epoch + 1 : 0;
+    group->key = utils::rand::bytes(AEAD_KEY_SIZE);
+    group->aead =
+        std::make_shared<utils::crypto::aead>(group->key.get(), VOICE_SERVER_NONCE_PREFIX);
+    _group_keys[channel_id] = group;
+
+    // Publish the new key to the fan-out list of the channel
+    rebuild_fanout(channel_id);
+
+    // Send the new key to all users connected to the channel
+    group_key_event = std::make_shared<events::voice_group_key_event>(
+        channel_id, std::string((char *)group->key.get(), AEAD_KEY_SIZE), group->epoch);
+    for (auto &join_pair : _joined_voice_channels) {
+        if (join_pair.second == channel_id) {
+            _server->event_manager()->trigger_event(
+                std::static_pointer_cast<quesync::event>(group_key_event), join_pair.first);
         }
     }
 }
 
 std::pair<std::string, quesync::voice::encryption_info>
-quesync::server::voice_manager::create_voice_session(std::string user_id) {
+quesync::server::voice_manager::create_voice_session(std::string user_id, std::string cipher) {
     std::lock_guard lk(_mutex);
 
     // If a session doesn't exists for the user
@@ -156,28 +918,78 @@ quesync::server::voice_manager::create_voice_session(std::string user_id) {
     }
 
     // Create the aes key and hmac key for the session
-    _session_keys[_sessions[user_id]] =
-        voice::encryption_info{utils::rand::bytes(AES_KEY_SIZE), utils::rand::bytes(HMAC_KEY_SIZE)};
+    voice::encryption_info keys{utils::rand::bytes(AES_KEY_SIZE),
+                                utils::rand::bytes(HMAC_KEY_SIZE)};
+
+    // Create the AEAD context once for the session so packets won't allocate one
+    if (cipher == VOICE_CIPHER_GCM) {
+        keys.aead =
+            std::make_shared<utils::crypto::aead>(keys.aes_key.get(), VOICE_SERVER_NONCE_PREFIX);
+    }
+
+    _session_keys[_sessions[user_id]] = keys;
+    _session_users[_sessions[user_id]] = user_id;
+
+    // Assign a new voice stream id to the session, 0 is reserved for no stream
+    _session_streams[_sessions[user_id]] = _next_stream_id++;
+    if (!_next_stream_id) {
+        _next_stream_id++;
+    }
+
+    // Count the new stream from scratch
+    _session_counters[_sessions[user_id]] = std::make_shared<stream_counters>();
+
+    // Update the route and the fan-out list of the session with the new keys
+    update_route(_sessions[user_id]);
+    rebuild_session_fanout(_sessions[user_id]);
 
     return *_session_keys.find(_sessions[user_id]);
 }
 
 void quesync::server::voice_manager::delete_voice_session(std::string user_id) {
+    std::string session_id;
+
     std::lock_guard lk(_mutex);
 
-    try {
-        // Remove OTP if exists
-        _otps.erase(_sessions[user_id]);
-    } catch (...) {
+    // If the user has no voice session, there is nothing to delete
+    if (!_sessions.count(user_id)) {
+        return;
+    }
+    session_id = _sessions[user_id];
+
+    // Remove OTPs of the session if exist
+    for (auto it = _otps.begin(); it != _otps.end();) {
+        if (it->second == session_id) {
+            it = _otps.erase(it);
+        } else {
+            it++;
+        }
     }
 
-    try {
-        _session_endpoints.erase(_sessions[user_id]);
-        _session_keys.erase(_sessions[user_id]);
-        _sessions.erase(user_id);
-    } catch (...) {
+    // Remove the route of the session
+    remove_route(session_id);
+
+    _session_endpoints.erase(session_id);
+    _session_keys.erase(session_id);
+    _session_streams.erase(session_id);
+    _session_counters.erase(session_id);
+
+    // Remove the session from the fan-out list of it's channel
+    rebuild_session_fanout(session_id);
+
+    _session_users.erase(session_id);
+    _sessions.erase(user_id);
+}
+
+uint32_t quesync::server::voice_manager::get_stream_id(std::string user_id) {
+    std::lock_guard lk(_mutex);
+
+    // Check if the user has a voice session
+    if (!_sessions.count(user_id)) {
         throw exception(error::voice_not_connected);
     }
+
+    return _session_streams[_sessions[user_id]];
 }
 
 std::string quesync::server::voice_manager::generate_otp(std::string session_id) {
@@ -189,29 +1001,60 @@ std::string quesync::server::voice_manager::generate_otp(std::string session_id)
     std::shared_ptr<unsigned char> bytes = utils::rand::bytes(OTP_SIZE);
 
     // Save the OTP
-    otp = std::string((char*)bytes.get(), OTP_SIZE);
+    otp = std::string((char *)bytes.get(), OTP_SIZE);
     _otps[otp] = session_id;
 
     return otp;
 }
 
 std::shared_ptr<quesync::call_details> quesync::server::voice_manager::init_voice_channel(
-    std::string caller_id, std::string channel_id, std::vector<std::string> users) {
+    std::string caller_id, std::string channel_id, std::vector<std::string> users,
+    bool group_key) {
     std::unordered_map<std::string, voice::state> user_states;
+    call new_call;
 
-    std::lock_guard lk(_mutex);
+    {
+        std::lock_guard lk(_mutex);
+
+        // If the voice channel already started
+        if (_voice_channels.count(channel_id) || _starting_channels.count(channel_id)) {
+            throw exception(error::call_already_started);
+        }
+
+        // Reserve the channel while it's call is created
+        _starting_channels.insert(channel_id);
+    }
+
+    try {
+        // Create the call without holding the lock, the database might be slow
+        new_call = create_call(caller_id, channel_id);
+    } catch (...) {
+        std::lock_guard lk(_mutex);
 
-    // If the voice channel already started
-    if (_voice_channels.count(channel_id)) {
-        throw exception(error::call_already_started);
+        _starting_channels.erase(channel_id);
+        throw;
     }
 
+    std::lock_guard lk(_mutex);
+
+    _starting_channels.erase(channel_id);
+
     // Create user states for all the users as PENDING
-    for (auto& user : users) {
+    for (auto &user : users) {
         user_states[user] = voice::state(voice::state_type::pending, false, false);
     }
-    _voice_channels[channel_id] =
-        std::make_shared<call_details>(create_call(caller_id, channel_id), user_states);
+    _voice_channels[channel_id] = std::make_shared<call_details>(new_call, user_states);
+
+    // Disconnect the users that won't join in time
+    for (auto &user : users) {
+        add_pending_state(channel_id, user);
+    }
+
+    // Create the first group key of the channel
+    if (group_key) {
+        _next_group_nonce_prefixes[channel_id] = VOICE_GROUP_NONCE_PREFIX_BASE;
+        rotate_group_key(channel_id);
+    }
 
     // Duplicate the call details and return it
     return std::make_shared<call_details>(*_voice_channels[channel_id]);
@@ -225,35 +1068,90 @@ bool quesync::server::voice_manager::is_voice_channel_active(std::string channel
 
 void quesync::server::voice_manager::join_voice_channel(std::string user_id, std::string channel_id,
                                                         bool muted, bool deafen) {
-    std::lock_guard lk(_mutex);
+    std::string call_id, ended_call_id;
+    bool joined;
 
-    // If the user is already in a channel, leave the channel
-    if (_joined_voice_channels.count(user_id)) {
-        leave_voice_channel(user_id);
+    {
+        std::lock_guard lk(_mutex);
+
+        // Check if the channel exists and check for active call
+        if (!_voice_channels.count(channel_id)) {
+            throw exception(error::channel_not_found);
+        }
+
+        call_id = _voice_channels[channel_id]->call.id;
     }
 
-    // Check if the channel exists and check for active call
-    if (!_voice_channels.count(channel_id)) {
-        throw exception(error::channel_not_found);
+    // Add the participant to the call without holding the lock, the database might be slow
+    add_participant_to_call(call_id, user_id);
+
+    {
+        std::lock_guard lk(_mutex);
+
+        // If the user is already in a channel, leave the channel
+        if (_joined_voice_channels.count(user_id)) {
+            ended_call_id = disconnect_user(user_id);
+        }
+
+        // Check that the call didn't end meanwhile
+        joined = _voice_channels.count(channel_id) &&
+                 _voice_channels[channel_id]->call.id == call_id;
+        if (joined) {
+            // Connect the user to the channel
+            _joined_voice_channels[user_id] = channel_id;
+            _voice_channels[channel_id]->voice_states[user_id] =
+                voice::state(voice::state_type::connected, muted, deafen);
+
+            // Publish the user's voice stream id so the participants can identify it's voice
+            if (_sessions.count(user_id)) {
+                _voice_channels[channel_id]->voice_states[user_id].set_stream_id(
+                    _session_streams[_sessions[user_id]]);
+            }
+
+            // Give the user a nonce prefix of it's own for the group key
+            if (_group_keys.count(channel_id)) {
+                _group_nonce_prefixes[user_id] = _next_group_nonce_prefixes[channel_id]++;
+            }
+
+            // Add the user to the fan-out list of the channel and route it's voice session to it
+            rebuild_fanout(channel_id);
+            if (_sessions.count(user_id)) {
+                update_route(_sessions[user_id]);
+            }
+            trigger_voice_state_event(channel_id, user_id,
+                                      _voice_channels[channel_id]->voice_states[user_id]);
+        }
     }
 
-    // Add the participant to the call
-    add_participant_to_call(channel_id, user_id);
+    // Close the call the user left if no one is left in it
+    if (!ended_call_id.empty()) {
+        queue_close_call(ended_call_id);
+    }
 
-    // Connect the user to the channel
-    _joined_voice_channels[user_id] = channel_id;
-    _voice_channels[channel_id]->voice_states[user_id] =
-        voice::state(voice::state_type::connected, muted, deafen);
-    trigger_voice_state_event(channel_id, user_id,
-                              _voice_channels[channel_id]->voice_states[user_id]);
+    if (!joined) {
+        throw exception(error::channel_not_found);
+    }
 }
 
 void quesync::server::voice_manager::leave_voice_channel(std::string user_id) {
-    std::string channel_id;
+    std::string ended_call_id;
 
-    std::shared_ptr<events::call_ended_event> call_ended_event;
+    {
+        std::lock_guard lk(_mutex);
 
-    std::lock_guard lk(_mutex);
+        ended_call_id = disconnect_user(user_id);
+    }
+
+    // Close the call without holding the lock, the database might be slow
+    if (!ended_call_id.empty()) {
+        queue_close_call(ended_call_id);
+    }
+}
+
+std::string quesync::server::voice_manager::disconnect_user(std::string user_id) {
+    std::string channel_id, call_id;
+
+    std::shared_ptr<events::call_ended_event> call_ended_event;
 
     // Check if in voice channel
     if (!_joined_voice_channels.count(user_id)) {
@@ -265,30 +1163,61 @@ void quesync::server::voice_manager::leave_voice_channel(std::string user_id) {
 
     // Remove the user from the map of joined voice channels
     _joined_voice_channels.erase(user_id);
+    _group_nonce_prefixes.erase(user_id);
     _voice_channels[channel_id]->voice_states[user_id] = voice::state_type::disconnected;
+
+    // Stop routing the user's voice session to the channel and remove it from the fan-out list
+    if (_sessions.count(user_id)) {
+        update_route(_sessions[user_id]);
+    }
+    rebuild_fanout(channel_id);
     trigger_voice_state_event(channel_id, user_id,
                               _voice_channels[channel_id]->voice_states[user_id]);
 
     // Check for others connected to the voice channel
-    for (auto& join_pair : _joined_voice_channels) {
+    for (auto &join_pair : _joined_voice_channels) {
         if (join_pair.second == channel_id) {
-            return;
+            // Rotate the group key so the user can't decrypt the rest of the call
+            if (_group_keys.count(channel_id)) {
+                rotate_group_key(channel_id);
+            }
+
+            return "";
         }
     }
 
     // Send call ended event for all participants of the call
     call_ended_event = std::make_shared<events::call_ended_event>(channel_id);
-    for (auto& user : _voice_channels[channel_id]->voice_states) {
+    for (auto &user : _voice_channels[channel_id]->voice_states) {
         if (user.first != user_id)
             _server->event_manager()->trigger_event(
                 std::static_pointer_cast<quesync::event>(call_ended_event), user.first);
     }
 
-    // Close the call in the channel
-    close_call(channel_id);
+    // The call ended, it's closed by the caller after releasing the lock
+    call_id = _voice_channels[channel_id]->call.id;
 
     // If the channel has no one connected to it, remove it
     _voice_channels.erase(channel_id);
+    _fanouts.erase(channel_id);
+    publish_mixed_channels();
+    _group_keys.erase(channel_id);
+    _next_group_nonce_prefixes.erase(channel_id);
+
+    return call_id;
+}
+
+std::pair<std::shared_ptr<const quesync::voice::group_key>, uint32_t>
+quesync::server::voice_manager::get_group_key(std::string user_id) {
+    std::lock_guard lk(_mutex);
+
+    // If the user isn't joined to a channel with a group key, it has no group key
+    if (!_joined_voice_channels.count(user_id) ||
+        !_group_keys.count(_joined_voice_channels[user_id])) {
+        return {nullptr, 0};
+    }
+
+    return {_group_keys[_joined_voice_channels[user_id]], _group_nonce_prefixes[user_id]};
 }
 
 std::unordered_map<std::string, quesync::voice::state>
@@ -303,31 +1232,63 @@ quesync::server::voice_manager::get_voice_states(std::string channel_id) {
     return _voice_channels[channel_id]->voice_states;
 }
 
-void quesync::server::voice_manager::handle_voice_states() {
-    while (true) {
-        // Sleep for half a second
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+void quesync::server::voice_manager::add_pending_state(std::string channel_id,
+                                                       std::string user_id) {
+    bool idle = _pending_states.empty();
 
-        std::lock_guard lk(_mutex);
+    _pending_states.push_back(voice::pending_state{
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(MAX_PENDING_MS),
+        _voice_channels[channel_id]->call.id, channel_id, user_id});
 
-        std::time_t current_time = std::time(nullptr);
-
-        // For each channel
-        for (auto& channel : _voice_channels) {
-            // For each user
-            for (auto& user : channel.second->voice_states) {
-                // If pending time exceeded, change the user's state
-                if (user.second == voice::state_type::pending &&
-                    current_time - user.second.change_time() > MAX_PENDING_SECONDS) {
-                    _voice_channels[channel.first]->voice_states[user.first] =
-                        voice::state_type::disconnected;
-                    trigger_voice_state_event(
-                        channel.first, user.first,
-                        _voice_channels[channel.first]->voice_states[user.first]);
-                }
-            }
+    // Later states never expire before the first one, so the timer is only armed when idle
+    if (idle) {
+        schedule_pending_states();
+    }
+}
+
+void quesync::server::voice_manager::schedule_pending_states() {
+    if (_pending_states.empty()) {
+        return;
+    }
+
+    _pending_timer.expires_at(_pending_states.front().deadline);
+    _pending_timer.async_wait([this](std::error_code ec) {
+        if (!ec) {
+            expire_pending_states();
         }
+    });
+}
+
+void quesync::server::voice_manager::expire_pending_states() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    std::lock_guard lk(_mutex);
+
+    // Handle only the states that their deadline has passed
+    while (!_pending_states.empty() && _pending_states.front().deadline <= now) {
+        voice::pending_state pending = _pending_states.front();
+        _pending_states.pop_front();
+
+        // Skip states of calls that ended or users that joined or left meanwhile
+        if (!_voice_channels.count(pending.channel_id) ||
+            _voice_channels[pending.channel_id]->call.id != pending.call_id) {
+            continue;
+        }
+
+        auto &voice_states = _voice_channels[pending.channel_id]->voice_states;
+        if (!voice_states.count(pending.user_id) ||
+            voice_states[pending.user_id].voice_state() != voice::state_type::pending) {
+            continue;
+        }
+
+        // The user didn't join in time, disconnect it
+        voice_states[pending.user_id] = voice::state_type::disconnected;
+        trigger_voice_state_event(pending.channel_id, pending.user_id,
+                                  voice_states[pending.user_id]);
     }
+
+    // Wait for the next deadline
+    schedule_pending_states();
 }
 
 void quesync::server::voice_manager::set_voice_state(std::string user_id, bool muted, bool deafen) {
@@ -365,7 +1326,7 @@ std::vector<quesync::call> quesync::server::voice_manager::get_channel_calls(
     int offset) {
     std::vector<call> calls;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table calls_table(_server->get_sql_schema(sql_sess), "calls");
     sql::RowResult res;
     sql::Row row;
@@ -425,7 +1386,7 @@ void quesync::server::voice_manager::trigger_voice_state_event(std::string chann
         std::make_shared<events::voice_state_event>(user_id, voice_state));
 
     // For each user in the channel
-    for (auto& user : voice_states) {
+    for (auto &user : voice_states) {
         // Check if the user is connected to the channel
         if (user.first != user_id && user.second == voice::state_type::connected) {
             _server->event_manager()->trigger_event(std::static_pointer_cast<quesync::event>(evt),
@@ -438,7 +1399,7 @@ quesync::call quesync::server::voice_manager::create_call(std::string caller_id,
                                                           std::string channel_id) {
     std::string call_id = sole::uuid4().str();
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table calls_table(_server->get_sql_schema(sql_sess), "calls");
 
     try {
@@ -454,15 +1415,15 @@ quesync::call quesync::server::voice_manager::create_call(std::string caller_id,
     return call(call_id, caller_id, channel_id, std::time(nullptr), false);
 }
 
-void quesync::server::voice_manager::add_participant_to_call(std::string channel_id,
+void quesync::server::voice_manager::add_participant_to_call(std::string call_id,
                                                              std::string participant_id) {
     try {
         // Try to insert the participant to the call participants table (ignore if already exists)
         _server->get_sql_session()
-            .sql(
+            ->sql(
                 "INSERT IGNORE INTO quesync.call_participants(call_id, participant_id) VALUES(?, "
                 "?)")
-            .bind(_voice_channels[channel_id]->call.id)
+            .bind(call_id)
             .bind(participant_id)
             .execute();
     } catch (...) {
@@ -470,13 +1431,26 @@ void quesync::server::voice_manager::add_participant_to_call(std::string channel
     }
 }
 
-void quesync::server::voice_manager::close_call(std::string channel_id) {
+void quesync::server::voice_manager::queue_close_call(std::string call_id) {
+    std::shared_ptr<database_executor> executor = _server->database_executor();
+
+    // Close the call on a database thread, since users also leave from the I/O threads when their
+    // session ends
+    if (executor && executor->post([this, call_id] { close_call(call_id); })) {
+        return;
+    }
+
+    // If the database threads are too busy or already stopped, close the call here
+    close_call(call_id);
+}
+
+void quesync::server::voice_manager::close_call(std::string call_id) {
     try {
         // Set end date
         _server->get_sql_session()
-            .sql("UPDATE calls SET end_date = FROM_UNIXTIME(?) WHERE id = ?")
+            ->sql("UPDATE calls SET end_date = FROM_UNIXTIME(?) WHERE id = ?")
             .bind(std::time(nullptr))
-            .bind(_voice_channels[channel_id]->call.id)
+            .bind(call_id)
             .execute();
     } catch (...) {
         throw exception(error::unknown_error);
@@ -486,7 +1460,7 @@ void quesync::server::voice_manager::close_call(std::string channel_id) {
 bool quesync::server::voice_manager::user_joined_call(std::string call_id, std::string user_id) {
     std::vector<std::string> call_participants;
 
-    sql::Session sql_sess = _server->get_sql_session();
+    sql_lease sql_sess = _server->get_sql_session();
     sql::Table call_participants_table(_server->get_sql_schema(sql_sess), "call_participants");
     sql::RowResult res;
 
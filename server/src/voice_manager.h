@@ -1,25 +1,49 @@
 #pragma once
 #include "manager.h"
 
+#include <array>
 #include <asio.hpp>
+#include <chrono>
+#include <deque>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 #include "../../shared/call_details.h"
 #include "../../shared/event.h"
+#include "../../shared/utils/crypto/aead.h"
+#include "../../shared/voice_header.h"
 #include "../../shared/voice_state.h"
+#include "../../shared/voice_stats.h"
+#include "stream_counters.h"
+#include "voice_mixer.h"
 
 #define VOICE_SERVER_PORT 61111
 
 #define MAX_DATA_LEN 8192
 
-#define MAX_PENDING_SECONDS 20
+#define MAX_PENDING_MS 20000
 
 #define MAX_CALLS_AMOUNT 250
 
+#define ROUTING_SHARDS 16
+
+#define VOICE_BATCH_SIZE 32
+
+#define VOICE_MAX_FREE_BUFFERS 1024
+
+#define SPEAKER_TIMEOUT_MS 300
+#define SPEAKER_LEVEL_SMOOTHING 0.3f
+#define SPEAKER_HYSTERESIS 3
+
 using asio::ip::udp;
 
 namespace quesync {
@@ -30,6 +54,198 @@ struct encryption_info {
 
     /// The buffer containing the HMAC key.
     std::shared_ptr<unsigned char> hmac_key;
+
+    /// The AES256-GCM context keyed with the AES key, null if the session uses AES256-CBC
+    /// with HMAC.
+    std::shared_ptr<utils::crypto::aead> aead;
+};
+
+struct participant {
+    /// The id of the participant.
+    std::string user_id;
+
+    /// The endpoint of the participant's voice session.
+    udp::endpoint endpoint;
+
+    /// The id of the voice stream of the participant's voice session.
+    uint32_t stream_id;
+
+    /// The encryption info of the participant's voice session.
+    encryption_info keys;
+};
+
+struct group_key {
+    /// The epoch of the key, incremented on every rotation.
+    uint32_t epoch;
+
+    /// The buffer containing the key.
+    std::shared_ptr<unsigned char> key;
+
+    /// The AES256-GCM context of the key, used to verify the voice of the senders.
+    std::shared_ptr<utils::crypto::aead> aead;
+};
+
+struct speaker {
+    /// The smoothed audio level of the speaker in -dBov, lower is louder.
+    float level;
+
+    /// Is the voice of the speaker currently forwarded.
+    bool forwarded;
+
+    /// The arrival time of the last packet of the speaker.
+    std::chrono::steady_clock::time_point last_packet;
+};
+
+struct fanout {
+    /// The participants connected to the channel with an authenticated voice session.
+    /// Replaced atomically on every change, must be accessed with std::atomic_load.
+    std::shared_ptr<const std::vector<participant>> participants;
+
+    /// The current group key of the channel, null if the channel doesn't use a group key.
+    /// Replaced atomically on every rotation, must be accessed with std::atomic_load.
+    std::shared_ptr<const group_key> group;
+
+    /// The mixer of the channel, null if the voice of the channel isn't mixed by the server.
+    /// Replaced atomically when the channel crosses the mixing threshold, must be accessed with
+    /// std::atomic_load.
+    std::shared_ptr<server::voice_mixer> mixer;
+
+    /// The recent speakers of the channel by their stream id.
+    std::unordered_map<uint32_t, speaker> speakers;
+    std::mutex speakers_mutex;
+};
+
+struct route {
+    /// The id of the voice session.
+    std::string session_id;
+
+    /// The id of the user that owns the voice session.
+    std::string user_id;
+
+    /// The id of the voice stream of the session.
+    uint32_t stream_id;
+
+    /// The encryption info of the voice session.
+    encryption_info keys;
+
+    /// The id of the voice channel the user is joined to, empty if not joined to any.
+    std::string channel_id;
+
+    /// The fan-out list of the joined voice channel, null if not joined to any.
+    std::shared_ptr<fanout> channel;
+
+    /// The nonce prefix the user must encrypt it's voice with when the channel uses a group key.
+    uint32_t group_nonce_prefix;
+
+    /// The counters of the session's voice stream.
+    std::shared_ptr<server::stream_counters> counters;
+};
+
+struct pending_state {
+    /// The time the pending state of the user expires.
+    std::chrono::steady_clock::time_point deadline;
+
+    /// The id of the call the user is pending in.
+    std::string call_id;
+
+    /// The id of the channel of the call.
+    std::string channel_id;
+
+    /// The id of the user.
+    std::string user_id;
+};
+
+struct endpoint_hash {
+    /**
+     * Calculates the hash of an UDP endpoint.
+     *
+     * @param endpoint The UDP endpoint.
+     * @return The hash of the endpoint.
+     */
+    std::size_t operator()(const udp::endpoint &endpoint) const {
+        std::size_t seed = std::hash<unsigned short>()(endpoint.port());
+
+        // Combine the hash of the address with the hash of the port
+        if (endpoint.address().is_v4()) {
+            combine(seed, std::hash<uint32_t>()(endpoint.address().to_v4().to_uint()));
+        } else {
+            for (auto byte : endpoint.address().to_v6().to_bytes()) {
+                combine(seed, std::hash<unsigned char>()(byte));
+            }
+        }
+
+        return seed;
+    }
+
+   private:
+    static void combine(std::size_t &seed, std::size_t hash) {
+        seed ^= hash + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+};
+
+struct datagram {
+    /// The data of the datagram.
+    std::shared_ptr<std::string> data;
+
+    /// The destination endpoint of the datagram.
+    udp::endpoint endpoint;
+};
+
+#ifdef __linux__
+struct batch {
+    /// The buffers of the received datagrams.
+    char bufs[VOICE_BATCH_SIZE][MAX_DATA_LEN];
+
+    /// The addresses of the senders of the received datagrams.
+    sockaddr_storage addrs[VOICE_BATCH_SIZE];
+
+    /// The I/O vectors of the received datagrams.
+    iovec recv_iovecs[VOICE_BATCH_SIZE];
+
+    /// The headers of the received datagrams.
+    mmsghdr recv_msgs[VOICE_BATCH_SIZE];
+
+    /// The I/O vectors of the datagrams to be sent.
+    iovec send_iovecs[VOICE_BATCH_SIZE];
+
+    /// The headers of the datagrams to be sent.
+    mmsghdr send_msgs[VOICE_BATCH_SIZE];
+
+    /// The datagrams that are waiting for the next flush.
+    std::vector<datagram> pending;
+};
+#endif
+
+struct ingress {
+    /**
+     * Ingress constructor.
+     *
+     * @param io_context The I/O context that handles the ingress socket.
+     */
+    ingress(asio::io_context &io_context) : socket(io_context), strand(io_context) {}
+
+    /// The socket that receives voice packets.
+    udp::socket socket;
+
+    /// A strand used to sync the receives and sends on the socket, since a socket object isn't
+    /// safe to use from several threads at once.
+    asio::io_context::strand strand;
+
+    /// The last sender endpoint.
+    udp::endpoint sender_endpoint;
+
+    /// The buffer for recv messages.
+    char buf[MAX_DATA_LEN];
+
+#ifdef __linux__
+    /// The state of the batched I/O, null when the socket uses the asio I/O path.
+    std::unique_ptr<batch> io_batch;
+#endif
+};
+
+struct routing_shard {
+    /// The routes of the endpoints that belong to the shard.
+    std::unordered_map<udp::endpoint, std::shared_ptr<const route>, endpoint_hash> routes;
 };
 };  // namespace voice
 
@@ -43,16 +259,44 @@ class voice_manager : manager {
      * Voice manager constructor.
      *
      * @param server A shared pointer to the server object.
+     * @param ingress_sockets The amount of voice sockets to open. When more than 1, each socket is
+     *                        bound to the voice port with SO_REUSEPORT and handled by a dedicated
+     *                        thread, the kernel keeps each client on the same socket by hashing
+     *                        it's address. The packets of each socket are handled one at a time,
+     *                        so the relay only runs in parallel with more than 1 socket.
+     * @param batch_io Use recvmmsg/sendmmsg to receive and send voice packets in batches. Only
+     *                 supported on Linux, other platforms use the asio I/O path.
+     * @param max_speakers The maximum amount of speakers forwarded in each channel, the loudest
+     *                     speakers are forwarded. 0 forwards all speakers.
+     * @param mix_threshold The amount of participants from which the voice of a channel is mixed
+     *                      by the server and each participant receives a single stream. 0 never
+     *                      mixes. Channels that use a group key are never mixed.
+     * @param stats_interval The interval in seconds to print the statistics of the voice streams
+     *                       in. 0 never prints them.
      */
-    voice_manager(std::shared_ptr<server> server);
+    voice_manager(std::shared_ptr<server> server, unsigned int ingress_sockets = 1,
+                  bool batch_io = false, unsigned int max_speakers = 0,
+                  unsigned int mix_threshold = 0, unsigned int stats_interval = 0);
+    ~voice_manager();
 
     /**
      * Creates a voice session for a user.
      *
      * @param user_id The id of the user.
+     * @param cipher The preferred cipher of the voice stream, unknown ciphers fall back to
+     *               AES256-CBC with HMAC.
      * @return A pair with the session id and trhe encryption info of the voice stream.
      */
-    std::pair<std::string, voice::encryption_info> create_voice_session(std::string user_id);
+    std::pair<std::string, voice::encryption_info> create_voice_session(
+        std::string user_id, std::string cipher = VOICE_CIPHER_CBC_HMAC);
+
+    /**
+     * Gets the id of the voice stream of a user's voice session.
+     *
+     * @param user_id The id of the user.
+     * @return The id of the voice stream.
+     */
+    uint32_t get_stream_id(std::string user_id);
 
     /**
      * Delete user's voice session.
@@ -75,10 +319,13 @@ class voice_manager : manager {
      * @param caller_id The id of the caller.
      * @param channel_id The id of the channel.
      * @param users The users in the channel.
+     * @param group_key Should the channel use a group key, so the voice of each sender is
+     *                  verified once and forwarded as is to all participants.
      * @return A shared pointer to the call details object.
      */
     std::shared_ptr<call_details> init_voice_channel(std::string caller_id, std::string channel_id,
-                                                     std::vector<std::string> users);
+                                                     std::vector<std::string> users,
+                                                     bool group_key = false);
 
     /**
      * Checks if a voice channel is active.
@@ -105,6 +352,16 @@ class voice_manager : manager {
      */
     void leave_voice_channel(std::string user_id);
 
+    /**
+     * Gets the group key of the user's voice channel.
+     *
+     * @param user_id The id of the user.
+     * @return A pair with the group key and the nonce prefix of the user, the key is null if the
+     *         user's channel doesn't use a group key.
+     */
+    std::pair<std::shared_ptr<const voice::group_key>, uint32_t> get_group_key(
+        std::string user_id);
+
     /**
      * Sets the user's voice state.
      *
@@ -122,6 +379,13 @@ class voice_manager : manager {
      */
     std::unordered_map<std::string, voice::state> get_voice_states(std::string channel_id);
 
+    /**
+     * Get the statistics of all voice streams.
+     *
+     * @return A vector containing the statistics of the voice stream of each voice session.
+     */
+    std::vector<quesync::voice::stream_stats> get_stream_stats();
+
     /**
      * Get channel calls history.
      *
@@ -135,14 +399,27 @@ class voice_manager : manager {
                                         int amount, int offset);
 
    private:
-    /// The voice server's socket.
-    udp::socket _socket;
+    /// The voice server's sockets.
+    std::vector<std::unique_ptr<voice::ingress>> _ingress;
 
-    /// The last sender endpoint.
-    udp::endpoint _sender_endpoint;
+    /// The dedicated I/O contexts of the voice sockets, empty when a single socket is used.
+    std::vector<std::unique_ptr<asio::io_context>> _ingress_contexts;
 
-    /// The buffer for recv messages.
-    char _buf[MAX_DATA_LEN];
+    /// The threads that run the dedicated I/O contexts.
+    std::vector<std::thread> _ingress_threads;
+
+    /// The maximum amount of speakers forwarded in each channel, 0 for no limit.
+    unsigned int _max_speakers;
+
+    /// The amount of participants from which a channel is mixed, 0 for never.
+    unsigned int _mix_threshold;
+
+    /// The fan-out lists of the mixed channels, replaced atomically when a channel starts or
+    /// stops being mixed, must be accessed with std::atomic_load.
+    std::shared_ptr<const std::vector<std::shared_ptr<voice::fanout>>> _mixed_channels;
+
+    /// The timer of the mixing ticks.
+    asio::steady_timer _mix_timer;
 
     /// A map of all voice channels.
     std::unordered_map<std::string, std::shared_ptr<call_details>> _voice_channels;
@@ -159,25 +436,111 @@ class voice_manager : manager {
     /// A map of all sessions.
     std::unordered_map<std::string, std::string> _sessions;
 
-    /// A map of OTPs for each user.
-    std::unordered_map<std::string, std::string> _otps;
+    /// A map of the owner user of each session.
+    std::unordered_map<std::string, std::string> _session_users;
 
-    std::mutex _mutex;
+    /// A map of the voice stream id of each session.
+    std::unordered_map<std::string, uint32_t> _session_streams;
+
+    /// A map of the voice stream counters of each session.
+    std::unordered_map<std::string, std::shared_ptr<stream_counters>> _session_counters;
+
+    /// The id of the next voice stream.
+    uint32_t _next_stream_id;
 
-    std::thread _voice_states_thread;
+    /// The routing table of the voice server, maps each authenticated endpoint to it's session.
+    /// Each shard is an immutable snapshot that is replaced atomically when one of it's routes
+    /// changes, so the packet path can read it without taking the mutex.
+    std::array<std::shared_ptr<const voice::routing_shard>, ROUTING_SHARDS> _routes;
 
-    void recv();
-    void send(std::shared_ptr<char> buf, std::size_t length, udp::endpoint endpoint);
+    /// A map of the fan-out list of each voice channel.
+    std::unordered_map<std::string, std::shared_ptr<voice::fanout>> _fanouts;
 
-    void handle_packet(std::size_t length);
+    /// A map of the current group key of each voice channel that uses a group key.
+    std::unordered_map<std::string, std::shared_ptr<const voice::group_key>> _group_keys;
 
-    void handle_voice_states();
+    /// A map of the next free group nonce prefix of each voice channel.
+    std::unordered_map<std::string, uint32_t> _next_group_nonce_prefixes;
+
+    /// A map of the group nonce prefix of each user joined to a voice channel.
+    std::unordered_map<std::string, uint32_t> _group_nonce_prefixes;
+
+    /// A map of OTPs for each user.
+    std::unordered_map<std::string, std::string> _otps;
+
+    /// The channels that their call is being created, reserved until it's created.
+    std::unordered_set<std::string> _starting_channels;
+
+    /// Lock for the voice channels and sessions state, taken only by writers of the routing table.
+    std::mutex _mutex;
+
+    /// The pending voice states ordered by their deadline. All the states share the same
+    /// timeout, so new states are always appended to the back.
+    std::deque<voice::pending_state> _pending_states;
+
+    /// The timer of the first pending state's deadline.
+    asio::steady_timer _pending_timer;
+
+    /// The interval in seconds to print the statistics of the voice streams in, 0 for never.
+    unsigned int _stats_interval;
+
+    /// The timer of the statistics printing.
+    asio::steady_timer _stats_timer;
+
+    void open_ingress(unsigned int ingress_sockets);
+
+    void recv(voice::ingress &ingress);
+#ifdef __linux__
+    void recv_batch(voice::ingress &ingress);
+    void handle_batch(voice::ingress &ingress);
+    void flush_batch(voice::ingress &ingress);
+#endif
+    void send(voice::ingress &ingress, std::shared_ptr<std::string> buf,
+              const udp::endpoint &endpoint);
+    std::shared_ptr<std::string> acquire_buffer();
+    void release_buffer(std::shared_ptr<std::string> buf);
+
+    void handle_packet(voice::ingress &ingress, const std::string &data,
+                       const udp::endpoint &sender_endpoint);
+    bool select_speaker(voice::fanout &channel, uint32_t stream_id, uint8_t level);
+    bool relay_group_packet(voice::ingress &ingress, const std::string &data,
+                            const udp::endpoint &sender_endpoint,
+                            std::shared_ptr<const voice::route> route,
+                            std::shared_ptr<const voice::group_key> group,
+                            std::chrono::steady_clock::time_point received);
+    void relay_report(voice::ingress &ingress, const std::string &data,
+                      const udp::endpoint &sender_endpoint,
+                      std::shared_ptr<const voice::route> route);
+
+    void redeem_otp(std::string otp, const udp::endpoint &sender_endpoint);
+
+    std::shared_ptr<const voice::route> find_route(const udp::endpoint &endpoint);
+    void publish_route(const udp::endpoint &endpoint, std::shared_ptr<const voice::route> route);
+    void update_route(std::string session_id);
+    void remove_route(std::string session_id);
+    void rebuild_fanout(std::string channel_id);
+    void rebuild_session_fanout(std::string session_id);
+    void rotate_group_key(std::string channel_id);
+    void publish_mixed_channels();
+
+    void schedule_mix();
+    void mix_channels();
+
+    void schedule_stats();
+    void print_stats();
+
+    void add_pending_state(std::string channel_id, std::string user_id);
+    void schedule_pending_states();
+    void expire_pending_states();
     void trigger_voice_state_event(std::string channel_id, std::string user_id,
                                    voice::state voice_state);
 
+    std::string disconnect_user(std::string user_id);
+
     call create_call(std::string caller_id, std::string channel_id);
-    void add_participant_to_call(std::string channel_id, std::string participant_id);
-    void close_call(std::string channel_id);
+    void add_participant_to_call(std::string call_id, std::string participant_id);
+    void queue_close_call(std::string call_id);
+    void close_call(std::string call_id);
     bool user_joined_call(std::string call_id, std::string user_id);
 };
 };  // namespace server
@@ -0,0 +1,181 @@
+#include "voice_mixer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+std::unordered_map<uint32_t, std::shared_ptr<quesync::packets::voice_packet>>
+quesync::server::voice_mixer::mix(const std::vector<uint32_t> &listeners) {
+    std::unordered_map<uint32_t, std::shared_ptr<packets::voice_packet>> mixes;
+    std::unordered_map<uint32_t, frame> spoken;
+    std::unordered_set<uint32_t> current_listeners(listeners.begin(), listeners.end());
+    encoded_mix shared_mix, own_mix;
+    bool shared_encoded = false, shared_valid = false;
+
+    int32_t sum[MIX_FRAME_SIZE] = {0};
+
+    std::lock_guard lk(_mutex);
+
+    // Sum the next frame of each speaker
+    for (auto it = _sources.begin(); it != _sources.end();) {
+        if (it->second.frames.empty()) {
+            // Remove speakers that stopped speaking
+            if (++it->second.idle_ticks > MIX_MAX_IDLE_TICKS) {
+                it = _sources.erase(it);
+            } else {
+                it++;
+            }
+
+            continue;
+        }
+
+        frame &speaker_frame = spoken[it->first] = it->second.frames.front();
+        it->second.frames.pop_front();
+        it->second.idle_ticks = 0;
+
+        for (int i = 0; i < MIX_FRAME_SIZE; i++) {
+            sum[i] += speaker_frame[i];
+        }
+
+        it++;
+    }
+
+    _timestamp += MIX_FRAME_SIZE;
+
+    // If no one spoke, send nothing
+    if (spoken.empty()) {
+        return mixes;
+    }
+
+    for (auto &listener : listeners) {
+        auto own = spoken.find(listener);
+        sequences &listener_sequences = _sequences[listener];
+
+        if (own == spoken.end()) {
+            // Listeners that didn't speak all get the same mix, encode it once
+            if (!shared_encoded) {
+                shared_valid = encode(_shared_sink, sum, nullptr, shared_mix);
+                shared_encoded = true;
+            }
+
+            if (shared_valid) {
+                mixes[listener] = std::make_shared<packets::voice_packet>(
+                    VOICE_MIXED_STREAM_ID, listener_sequences.shared++, _timestamp,
+                    shared_mix.level, (char *)shared_mix.data, (unsigned int)shared_mix.len);
+            }
+        } else if (encode(_sinks[listener], sum, own->second.data(), own_mix)) {
+            // Speakers get the mix without their own voice on their personal stream
+            mixes[listener] = std::make_shared<packets::voice_packet>(
+                VOICE_PERSONAL_MIX_STREAM_ID, listener_sequences.personal++, _timestamp,
+                own_mix.level, (char *)own_mix.data, (unsigned int)own_mix.len);
+        }
+    }
+
+    // Remove the streams of listeners that stopped speaking
+    for (auto it = _sinks.begin(); it != _sinks.end();) {
+        if (!spoken.count(it->first) && ++it->second.idle_ticks > MIX_MAX_IDLE_TICKS) {
+            it = _sinks.erase(it);
+        } else {
+            if (spoken.count(it->first)) {
+                it->second.idle_ticks = 0;
+            }
+
+            it++;
+        }
+    }
+
+    // Remove the sequence numbers of listeners that left the channel
+    for (auto it = _sequences.begin(); it != _sequences.end();) {
+        if (!current_listeners.count(it->first)) {
+            it = _sequences.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    return mixes;
+}
+
+void quesync::server::voice_mixer::push(const packets::voice_packet &packet) {
+    int16_t decoded[MIX_FRAME_SIZE * MIX_MAX_PACKET_FRAMES];
+    frame decoded_frame;
+    int error = 0, decoded_size = 0;
+
+    std::lock_guard lk(_mutex);
+
+    source &speaker = _sources[packet.stream_id()];
+
+    // Create the decoder of the speaker's stream
+    if (!speaker.decoder) {
+        speaker.decoder.reset(opus_decoder_create(MIX_FREQUENCY, 1, &error));
+        if (error != OPUS_OK) {
+            _sources.erase(packet.stream_id());
+            return;
+        }
+    }
+
+    // Decode the packet, the sender may pack a few frames into each packet
+    decoded_size =
+        opus_decode(speaker.decoder.get(), (const unsigned char *)packet.voice_data(),
+                    packet.voice_data_len(), decoded, MIX_FRAME_SIZE * MIX_MAX_PACKET_FRAMES, 0);
+    if (decoded_size <= 0 || decoded_size % MIX_FRAME_SIZE) {
+        return;
+    }
+
+    // Queue the frames, if the speaker is too far ahead drop it's oldest frames
+    for (int offset = 0; offset < decoded_size; offset += MIX_FRAME_SIZE) {
+        std::copy(decoded + offset, decoded + offset + MIX_FRAME_SIZE, decoded_frame.begin());
+        speaker.frames.push_back(decoded_frame);
+    }
+    while (speaker.frames.size() > MIX_MAX_QUEUED_FRAMES) {
+        speaker.frames.pop_front();
+    }
+}
+
+bool quesync::server::voice_mixer::encode(sink &sink, const int32_t *mix, const int16_t *own,
+                                          encoded_mix &encoded) {
+    int16_t pcm[MIX_FRAME_SIZE];
+
+    double square_sum = 0, sample = 0;
+
+    // Create the encoder of the stream
+    if (!sink.encoder && !init_sink(sink)) {
+        return false;
+    }
+
+    // Remove the listener's voice from the mix and clip it
+    for (int i = 0; i < MIX_FRAME_SIZE; i++) {
+        pcm[i] = (int16_t)std::clamp<int32_t>(mix[i] - (own ? own[i] : 0),
+                                              std::numeric_limits<int16_t>::min(),
+                                              std::numeric_limits<int16_t>::max());
+
+        sample = pcm[i] / (double)std::numeric_limits<int16_t>::max();
+        square_sum += sample * sample;
+    }
+
+    // Calculate the audio level of the mix
+    encoded.level = VOICE_LEVEL_SILENCE;
+    if (square_sum > 0) {
+        encoded.level = (uint8_t)std::clamp<double>(-10 * log10(square_sum / MIX_FRAME_SIZE), 0,
+                                                    VOICE_LEVEL_SILENCE);
+    }
+
+    encoded.len = opus_encode(sink.encoder.get(), pcm, MIX_FRAME_SIZE, encoded.data,
+                              sizeof(encoded.data));
+
+    return encoded.len > 0;
+}
+
+bool quesync::server::voice_mixer::init_sink(sink &sink) {
+    int error = 0;
+
+    sink.encoder.reset(opus_encoder_create(MIX_FREQUENCY, 1, OPUS_APPLICATION_VOIP, &error));
+    if (error != OPUS_OK) {
+        sink.encoder.reset();
+        return false;
+    }
+
+    opus_encoder_ctl(sink.encoder.get(), OPUS_SET_BITRATE(MIX_BITRATE));
+
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <opus.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../../shared/packets/voice_packet.h"
+
+#define MIX_FREQUENCY 48000
+#define MIX_FRAME_SIZE 480
+#define MIX_INTERVAL_MS 10
+#define MIX_MAX_PACKET_FRAMES 4
+#define MIX_MAX_QUEUED_FRAMES 8
+#define MIX_MAX_IDLE_TICKS 50
+#define MIX_BITRATE 32000
+#define MIX_MAX_PACKET_LEN 1275
+
+namespace quesync {
+namespace server {
+class voice_mixer {
+   public:
+    /**
+     * Mixes the next frame of all speakers and encodes it for each listener.
+     *
+     * Listeners that didn't speak in the frame share a single encoded mix, speakers get their
+     * own encoded mix without their voice on a separate stream. Each listener has it's own
+     * sequence numbers on each stream, so switching between them never looks like loss.
+     *
+     * @param listeners The stream ids of the listeners.
+     * @return A map of the mixed voice packet of each listener, empty if no one spoke.
+     */
+    std::unordered_map<uint32_t, std::shared_ptr<packets::voice_packet>> mix(
+        const std::vector<uint32_t> &listeners);
+
+    /**
+     * Decodes a voice packet of a speaker and queues it for the next mixes.
+     *
+     * @param packet The voice packet.
+     */
+    void push(const packets::voice_packet &packet);
+
+   private:
+    typedef std::array<int16_t, MIX_FRAME_SIZE> frame;
+
+    struct source {
+        /// The decoder of the speaker's stream.
+        std::unique_ptr<OpusDecoder, decltype(&opus_decoder_destroy)> decoder{
+            nullptr, &opus_decoder_destroy};
+
+        /// The decoded frames waiting to be mixed.
+        std::deque<frame> frames;
+
+        /// The amount of mixes since the speaker had a frame.
+        unsigned int idle_ticks = 0;
+    };
+
+    struct sink {
+        /// The encoder of the mixed stream.
+        std::unique_ptr<OpusEncoder, decltype(&opus_encoder_destroy)> encoder{
+            nullptr, &opus_encoder_destroy};
+
+        /// The amount of mixes since the listener spoke.
+        unsigned int idle_ticks = 0;
+    };
+
+    struct sequences {
+        /// The sequence number of the listener's next packet of the shared mix.
+        uint16_t shared = 0;
+
+        /// The sequence number of the listener's next packet of it's personal mix.
+        uint16_t personal = 0;
+    };
+
+    struct encoded_mix {
+        /// The encoded frame.
+        unsigned char data[MIX_MAX_PACKET_LEN];
+        int len = 0;
+
+        /// The audio level of the frame.
+        uint8_t level = VOICE_LEVEL_SILENCE;
+    };
+
+    bool encode(sink &sink, const int32_t *mix, const int16_t *own, encoded_mix &encoded);
+    static bool init_sink(sink &sink);
+
+    /// The speakers of the channel by their stream id.
+    std::unordered_map<uint32_t, source> _sources;
+
+    /// The mixed streams of the listeners that spoke recently by their stream id.
+    std::unordered_map<uint32_t, sink> _sinks;
+
+    /// The mixed stream shared by all the listeners that didn't speak.
+    sink _shared_sink;
+
+    /// The sequence numbers of each listener by it's stream id.
+    std::unordered_map<uint32_t, sequences> _sequences;
+
+    /// The timestamp of the next mixed frame.
+    uint32_t _timestamp = 0;
+
+    std::mutex _mutex;
+};
+};  // namespace server
+};  // namespace quesync
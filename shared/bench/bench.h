@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace quesync {
+namespace bench {
+/// Results of the measured functions are accumulated here so the compiler can't drop them.
+inline volatile uint64_t sink = 0;
+
+/**
+ * Runs a function repeatedly and measures the average time of a run.
+ *
+ * @tparam Func The type of the function, it returns a value that is accumulated to the sink.
+ * @param iterations The amount of times to run the function.
+ * @param func The function to measure.
+ * @return The average time of a run in nanoseconds.
+ */
+template <typename Func>
+double measure(std::size_t iterations, Func func) {
+    uint64_t result = 0;
+
+    // Warm up the caches and the branch predictors before measuring
+    for (std::size_t i = 0; i < iterations / 10 + 1; i++) {
+        result += (uint64_t)func(i);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; i++) {
+        result += (uint64_t)func(i);
+    }
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+
+    sink = sink + result;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+/**
+ * Prints a row of a benchmark's results table.
+ *
+ * @param name The name of the measured case.
+ * @param value The measured value.
+ * @param unit The unit of the measured value.
+ */
+inline void report(const std::string &name, double value, const std::string &unit) {
+    std::cout << std::left << std::setw(40) << name << std::right << std::setw(14) << std::fixed
+              << std::setprecision(1) << value << " " << unit << "\n";
+}
+};  // namespace bench
+};  // namespace quesync
@@ -40,6 +40,7 @@ enum class error {
     profile_photo_too_big,
     already_connected_in_other_location,
     sound_device_not_found,
-    invalid_sound_device
+    invalid_sound_device,
+    server_busy
 };
 };
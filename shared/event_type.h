@@ -11,6 +11,8 @@ enum class event_type {
     voice_activity_event,
     call_ended_event,
     file_transmission_progress_event,
-    server_disconnect_event
+    server_disconnect_event,
+    voice_group_key_event,
+    voice_stats_event
 };
 };
@@ -0,0 +1,49 @@
+#pragma once
+#include "../event.h"
+
+#include "../utils/crypto/base64.h"
+
+namespace quesync {
+namespace events {
+struct voice_group_key_event : public event {
+    /// Default constructor.
+    voice_group_key_event() : event(event_type::voice_group_key_event) {}
+
+    /**
+     * Event constructor.
+     *
+     * @param channel_id The id of the channel.
+     * @param key The new group key of the channel.
+     * @param epoch The epoch of the new group key.
+     */
+    voice_group_key_event(std::string channel_id, std::string key, uint32_t epoch)
+        : event(event_type::voice_group_key_event) {
+        this->channel_id = channel_id;
+        this->key = key;
+        this->epoch = epoch;
+    }
+
+    virtual nlohmann::json encode() const {
+        return {{"eventType", type},
+                {"channelId", channel_id},
+                {"key", utils::crypto::base64::encode(key)},
+                {"epoch", epoch}};
+    }
+    virtual void decode(nlohmann::json j) {
+        type = j["eventType"];
+        channel_id = j["channelId"];
+        key = utils::crypto::base64::decode(j["key"]);
+        epoch = j["epoch"];
+    }
+
+    /// The id of the channel.
+    std::string channel_id;
+
+    /// The new group key of the channel.
+    std::string key;
+
+    /// The epoch of the new group key.
+    uint32_t epoch;
+};
+};  // namespace events
+};  // namespace quesync
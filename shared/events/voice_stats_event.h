@@ -0,0 +1,59 @@
+#pragma once
+#include "../event.h"
+
+#include <vector>
+
+#include "../voice_stats.h"
+
+namespace quesync {
+namespace events {
+struct voice_stats_event : public event {
+    /// Default constructor.
+    voice_stats_event() : event(event_type::voice_stats_event) {}
+
+    /**
+     * Event constructor.
+     *
+     * @param streams The statistics of the sent and received voice streams.
+     * @param rtt The round trip time to the voice server in milliseconds.
+     * @param overruns The amount of captured frames that were dropped.
+     * @param underruns The amount of times there was no frame to play.
+     */
+    voice_stats_event(std::vector<voice::stream_stats> streams, uint32_t rtt, uint64_t overruns,
+                      uint64_t underruns)
+        : event(event_type::voice_stats_event) {
+        this->streams = streams;
+        this->rtt = rtt;
+        this->overruns = overruns;
+        this->underruns = underruns;
+    }
+
+    virtual nlohmann::json encode() const {
+        return {{"eventType", type},
+                {"streams", streams},
+                {"rtt", rtt},
+                {"overruns", overruns},
+                {"underruns", underruns}};
+    }
+    virtual void decode(nlohmann::json j) {
+        type = j["eventType"];
+        streams = j["streams"].get<std::vector<voice::stream_stats>>();
+        rtt = j["rtt"];
+        overruns = j["overruns"];
+        underruns = j["underruns"];
+    }
+
+    /// The statistics of the sent and received voice streams.
+    std::vector<voice::stream_stats> streams;
+
+    /// The round trip time to the voice server in milliseconds.
+    uint32_t rtt;
+
+    /// The amount of captured frames that were dropped.
+    uint64_t overruns;
+
+    /// The amount of times there was no frame to play.
+    uint64_t underruns;
+};
+};  // namespace events
+};  // namespace quesync
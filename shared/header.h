@@ -2,6 +2,21 @@
 
 #include <cstdint>
 
+/// The original revision of the protocol, a single request is in-flight at a time.
+#define PROTOCOL_VERSION 1
+
+/// The multiplexed revision of the protocol, each frame carries the ID of it's request.
+#define PROTOCOL_MULTIPLEXED_VERSION 2
+
+/// The bits of the version field that hold the revision of the protocol.
+#define PROTOCOL_REVISION_MASK 0xFF
+
+/// The shift of the request ID in the version field of a multiplexed frame.
+#define PROTOCOL_REQUEST_ID_SHIFT 8
+
+/// The max request ID, request ID 0 is kept for events pushed by the server.
+#define PROTOCOL_MAX_REQUEST_ID 0xFFFFFF
+
 namespace quesync {
 struct header {
     /// The version of the Quesync protocol.
@@ -9,5 +24,32 @@ struct header {
 
     /// The size of the packet.
     uint32_t size;
+
+    /**
+     * Gets the revision of the protocol the frame is encoded in.
+     *
+     * @return The revision of the protocol.
+     */
+    uint32_t revision() const { return version & PROTOCOL_REVISION_MASK; }
+
+    /**
+     * Gets the ID of the request the frame belongs to.
+     *
+     * @return The ID of the request, 0 for frames of the original revision and events.
+     */
+    uint32_t request_id() const {
+        return revision() == PROTOCOL_MULTIPLEXED_VERSION ? version >> PROTOCOL_REQUEST_ID_SHIFT
+                                                          : 0;
+    }
+
+    /**
+     * Gets the version field of a multiplexed frame.
+     *
+     * @param request_id The ID of the request the frame belongs to.
+     * @return The version field of the frame.
+     */
+    static uint32_t multiplexed_version(uint32_t request_id) {
+        return (request_id << PROTOCOL_REQUEST_ID_SHIFT) | PROTOCOL_MULTIPLEXED_VERSION;
+    }
 };
 };  // namespace quesync
@@ -9,6 +9,7 @@
 #include "../utils/crypto/aes256.h"
 #include "../utils/crypto/base64.h"
 #include "../utils/crypto/hmac.h"
+#include "../voice_header.h"
 #include "../voice_state.h"
 
 namespace quesync {
@@ -24,12 +25,17 @@ class call_request_packet : public serialized_packet {
      * @param channel_id The id of the channel.
      * @param muted The mute status of the input device.
      * @param deafen The mute status of the output device.
+     * @param voice_cipher The preferred cipher of the voice session.
+     * @param group_key Should the call use a group key so the server forwards the voice as is.
      */
-    call_request_packet(std::string channel_id, bool muted, bool deafen)
+    call_request_packet(std::string channel_id, bool muted, bool deafen,
+                        std::string voice_cipher = VOICE_CIPHER_CBC_HMAC, bool group_key = false)
         : serialized_packet(packet_type::call_request_packet) {
         _data["channelId"] = channel_id;
         _data["muted"] = muted;
         _data["deafen"] = deafen;
+        _data["voiceCipher"] = voice_cipher;
+        _data["groupKey"] = group_key;
     };
 
     virtual bool verify() const {
@@ -43,6 +49,7 @@ class call_request_packet : public serialized_packet {
 
         std::shared_ptr<call_details> call_details;
         std::pair<std::string, voice::encryption_info> voice_session_details;
+        std::pair<std::shared_ptr<const voice::group_key>, uint32_t> group_key;
         std::vector<std::string> users;
 
         nlohmann::json res;
@@ -65,8 +72,8 @@ class call_request_packet : public serialized_packet {
             }
 
             // Create a voice session for the user
-            voice_session_details =
-                session->server()->voice_manager()->create_voice_session(session->user()->id);
+            voice_session_details = session->server()->voice_manager()->create_voice_session(
+                session->user()->id, _data.value("voiceCipher", VOICE_CIPHER_CBC_HMAC));
 
             // Generate OTP for the session
             res["voiceSessionOTP"] = utils::crypto::base64::encode(
@@ -74,7 +81,7 @@ class call_request_packet : public serialized_packet {
 
             // Create a voice channel for the users
             call_details = session->server()->voice_manager()->init_voice_channel(
-                session->user()->id, _data["channelId"], users);
+                session->user()->id, _data["channelId"], users, _data.value("groupKey", false));
 
             // Join the voice channel
             session->server()->voice_manager()->join_voice_channel(
@@ -99,6 +106,19 @@ class call_request_packet : public serialized_packet {
             res["voiceSessionHMACKey"] = utils::crypto::base64::encode(
                 std::string((char *)voice_session_details.second.hmac_key.get(), HMAC_KEY_SIZE));
             res["voiceSessionId"] = voice_session_details.first;
+            res["voiceStreamId"] =
+                session->server()->voice_manager()->get_stream_id(session->user()->id);
+            res["voiceCipher"] =
+                voice_session_details.second.aead ? VOICE_CIPHER_GCM : VOICE_CIPHER_CBC_HMAC;
+
+            // Set the group key of the channel if it uses one
+            group_key = session->server()->voice_manager()->get_group_key(session->user()->id);
+            if (group_key.first) {
+                res["voiceGroupKey"] = utils::crypto::base64::encode(
+                    std::string((char *)group_key.first->key.get(), AEAD_KEY_SIZE));
+                res["voiceGroupKeyEpoch"] = group_key.first->epoch;
+                res["voiceGroupNoncePrefix"] = group_key.second;
+            }
             res["callDetails"] = *call_details;
 
             // Send the call event to the other users
@@ -7,6 +7,7 @@
 #include "../exception.h"
 #include "../utils/crypto/aes256.h"
 #include "../utils/crypto/base64.h"
+#include "../voice_header.h"
 #include "../voice_state.h"
 
 namespace quesync {
@@ -22,12 +23,15 @@ class join_call_request_packet : public serialized_packet {
      * @param channel_id The id of the channel.
      * @param muted The mute status of the input device.
      * @param deafen The mute status of the output device.
+     * @param voice_cipher The preferred cipher of the voice session.
      */
-    join_call_request_packet(std::string channel_id, bool muted, bool deafen)
+    join_call_request_packet(std::string channel_id, bool muted, bool deafen,
+                             std::string voice_cipher = VOICE_CIPHER_CBC_HMAC)
         : serialized_packet(packet_type::join_call_request_packet) {
         _data["channelId"] = channel_id;
         _data["muted"] = muted;
         _data["deafen"] = deafen;
+        _data["voiceCipher"] = voice_cipher;
     };
 
     virtual bool verify() const {
@@ -38,6 +42,7 @@ class join_call_request_packet : public serialized_packet {
 #ifdef QUESYNC_SERVER
     virtual std::string handle(std::shared_ptr<server::session> session) {
         std::pair<std::string, voice::encryption_info> voice_session_details;
+        std::pair<std::shared_ptr<const voice::group_key>, uint32_t> group_key;
         std::unordered_map<std::string, voice::state> voice_states;
 
         nlohmann::json res;
@@ -55,8 +60,8 @@ class join_call_request_packet : public serialized_packet {
             }
 
             // Create a voice session for the user
-            voice_session_details =
-                session->server()->voice_manager()->create_voice_session(session->user()->id);
+            voice_session_details = session->server()->voice_manager()->create_voice_session(
+                session->user()->id, _data.value("voiceCipher", VOICE_CIPHER_CBC_HMAC));
 
             // Generate OTP for the session
             res["voiceSessionOTP"] = utils::crypto::base64::encode(
@@ -78,6 +83,19 @@ class join_call_request_packet : public serialized_packet {
             res["voiceSessionHMACKey"] = utils::crypto::base64::encode(
                 std::string((char *)voice_session_details.second.hmac_key.get(), HMAC_KEY_SIZE));
             res["voiceSessionId"] = voice_session_details.first;
+            res["voiceStreamId"] =
+                session->server()->voice_manager()->get_stream_id(session->user()->id);
+            res["voiceCipher"] =
+                voice_session_details.second.aead ? VOICE_CIPHER_GCM : VOICE_CIPHER_CBC_HMAC;
+
+            // Set the group key of the channel if it uses one
+            group_key = session->server()->voice_manager()->get_group_key(session->user()->id);
+            if (group_key.first) {
+                res["voiceGroupKey"] = utils::crypto::base64::encode(
+                    std::string((char *)group_key.first->key.get(), AEAD_KEY_SIZE));
+                res["voiceGroupKeyEpoch"] = group_key.first->epoch;
+                res["voiceGroupNoncePrefix"] = group_key.second;
+            }
             res["voiceStates"] = voice_states;
 
             // Return response packet with the voice info
@@ -1,54 +1,79 @@
 #pragma once
 
-#include <iostream>
-#include <sstream>
+#include <cstdint>
 #include <string>
 
-#include "../packet.h"
-#include "../utils/parser.h"
+#include "../utils/serialization.h"
 
 #define MAX_VOICE_DATA_LEN 4096
 
+#define VOICE_PACKET_VERSION 1
+#define VOICE_PACKET_HEADER_SIZE 12
+
+#define VOICE_LEVEL_SILENCE 127
+
+#define VOICE_MIXED_STREAM_ID 0xFFFFFFFF
+#define VOICE_PERSONAL_MIX_STREAM_ID 0xFFFFFFFE
+
 namespace quesync {
 namespace packets {
 class voice_packet {
    public:
     /// Default constructor.
-    voice_packet(){};
+    voice_packet() : voice_packet(0, 0, 0, VOICE_LEVEL_SILENCE, nullptr, 0){};
 
     /**
      * Packet constructor.
      *
-     * @param user_id The id of the user.
-     * @param session_id The id of the voice session.
-     * @param channel_id The id of the channel.
+     * @param stream_id The id of the voice stream of the sender.
+     * @param sequence The sequence number of the packet in the stream.
+     * @param timestamp The timestamp of the first sample of the packet.
+     * @param level The audio level of the packet in -dBov, 0 is the loudest and 127 is silence.
      * @param voice_data The encoded opus data.
      * @param voice_data_len The length of the encoded opus data.
      */
-    voice_packet(std::string user_id, std::string session_id, std::string channel_id,
-                 char *voice_data, unsigned int voice_data_len)
-        : _user_id(user_id),
-          _session_id(session_id),
-          _channel_id(channel_id),
-          _voice_data(new char[voice_data_len]),
-          _voice_data_len(voice_data_len) {
-        memcpy(_voice_data, voice_data, voice_data_len);
-    }
+    voice_packet(uint32_t stream_id, uint16_t sequence, uint32_t timestamp, uint8_t level,
+                 const char *voice_data, unsigned int voice_data_len)
+        : _stream_id(stream_id),
+          _sequence(sequence),
+          _timestamp(timestamp),
+          _level(level > VOICE_LEVEL_SILENCE ? VOICE_LEVEL_SILENCE : level),
+          _voice_data(voice_data, voice_data_len) {}
 
     /**
      * Encode the packet.
      *
+     * The packet is a fixed binary header in network byte order followed by the opus data:
+     * version (8 bits), audio level (8 bits), sequence (16 bits), stream id (32 bits) and
+     * timestamp (32 bits).
+     *
      * @return The packet encoded.
      */
-    std::string encode() {
-        std::stringstream encoded_packet;
+    std::string encode() const {
+        std::string encoded_packet;
 
-        encoded_packet << _user_id << PACKET_DELIMETER;
-        encoded_packet << _session_id << PACKET_DELIMETER;
-        encoded_packet << _channel_id << PACKET_DELIMETER;
-        encoded_packet << std::string(_voice_data, _voice_data_len) << PACKET_DELIMETER;
+        encode(encoded_packet);
 
-        return encoded_packet.str();
+        return encoded_packet;
+    }
+
+    /**
+     * Encode the packet into a reused buffer.
+     *
+     * @param encoded_packet The buffer to write the encoded packet to, it's capacity is reused.
+     */
+    void encode(std::string &encoded_packet) const {
+        encoded_packet.resize(VOICE_PACKET_HEADER_SIZE + _voice_data.length());
+        unsigned char *header = (unsigned char *)&encoded_packet[0];
+
+        header[0] = VOICE_PACKET_VERSION;
+        header[1] = _level;
+        utils::serialization::write_uint16(header + 2, _sequence);
+        utils::serialization::write_uint32(header + 4, _stream_id);
+        utils::serialization::write_uint32(header + 8, _timestamp);
+
+        // Copy the voice data after the header
+        _voice_data.copy(&encoded_packet[VOICE_PACKET_HEADER_SIZE], _voice_data.length());
     }
 
     /**
@@ -57,74 +82,76 @@ class voice_packet {
      * @param buf The packet's encoded data.
      * @return True if the packet was decoded successfully or false otherwise.
      */
-    bool decode(std::string buf) {
-        // Split the packet
-        std::vector<std::string> params = utils::parser::split(buf, PACKET_DELIMETER);
-
-        if (params.size() >= 4) {
-            // Parse the packet
-            _user_id = params[0];
-            _session_id = params[1];
-            _channel_id = params[2];
-
-            // Parse voice data
-            _voice_data_len =
-                (unsigned int)(buf.length() - (_user_id.length() + _session_id.length() +
-                                               _channel_id.length() + 4));
-            _voice_data = new char[_voice_data_len];
-            memcpy(
-                _voice_data,
-                buf.c_str() + (_user_id.length() + _session_id.length() + _channel_id.length() + 3),
-                _voice_data_len);
-        } else {
+    bool decode(const std::string &buf) {
+        const unsigned char *header = (const unsigned char *)buf.data();
+
+        // Check the header exists and the version is supported
+        if (buf.length() < VOICE_PACKET_HEADER_SIZE || header[0] != VOICE_PACKET_VERSION ||
+            buf.length() - VOICE_PACKET_HEADER_SIZE > MAX_VOICE_DATA_LEN) {
             return false;
         }
 
+        // Parse the header
+        _level = header[1] > VOICE_LEVEL_SILENCE ? VOICE_LEVEL_SILENCE : header[1];
+        _sequence = utils::serialization::read_uint16(header + 2);
+        _stream_id = utils::serialization::read_uint32(header + 4);
+        _timestamp = utils::serialization::read_uint32(header + 8);
+
+        // Parse voice data
+        _voice_data.assign(buf, VOICE_PACKET_HEADER_SIZE, std::string::npos);
+
         return true;
     }
 
     /**
-     * Get the user id.
+     * Get the stream id.
+     *
+     * @return The id of the voice stream of the sender.
+     */
+    uint32_t stream_id() const { return _stream_id; }
+
+    /**
+     * Get the sequence number.
      *
-     * @return The user id.
+     * @return The sequence number of the packet in the stream.
      */
-    std::string user_id() { return _user_id; }
+    uint16_t sequence() const { return _sequence; }
 
     /**
-     * Get the session id.
+     * Get the timestamp.
      *
-     * @return The session id.
+     * @return The timestamp of the first sample of the packet.
      */
-    std::string session_id() { return _session_id; }
+    uint32_t timestamp() const { return _timestamp; }
 
     /**
-     * Get the channel id.
+     * Get the audio level.
      *
-     * @return The channel id.
+     * @return The audio level of the packet in -dBov, 0 is the loudest and 127 is silence.
      */
-    std::string channel_id() { return _channel_id; }
+    uint8_t level() const { return _level; }
 
     /**
      * Get the voice data which is the encoded opus data.
      *
      * @return The voice data.
      */
-    char *voice_data() { return _voice_data; }
+    const char *voice_data() const { return _voice_data.data(); }
 
     /**
      * Get the voice data length.
      *
      * @return The voice data length.
      */
-    unsigned int voice_data_len() { return _voice_data_len; }
+    unsigned int voice_data_len() const { return (unsigned int)_voice_data.length(); }
 
    private:
-    std::string _user_id;
-    std::string _session_id;
-    std::string _channel_id;
+    uint32_t _stream_id;
+    uint16_t _sequence;
+    uint32_t _timestamp;
+    uint8_t _level;
 
-    char *_voice_data;
-    unsigned int _voice_data_len;
+    std::string _voice_data;
 };
 };  // namespace packets
-};  // namespace quesync
\ No newline at end of file
+};  // namespace quesync
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "../utils/serialization.h"
+
+#define VOICE_REPORT_VERSION 0x81
+#define VOICE_REPORT_SIZE 14
+
+namespace quesync {
+namespace packets {
+class voice_report_packet {
+   public:
+    /// Default constructor.
+    voice_report_packet() : voice_report_packet(0, 0, 0, 0, 0){};
+
+    /**
+     * Packet constructor.
+     *
+     * @param stream_id The id of the reported voice stream.
+     * @param loss The fraction of the stream's packets that were lost, in 1/255 units.
+     * @param jitter The inter-arrival jitter of the stream in milliseconds.
+     * @param rtt The round trip time between the reporter and the server in milliseconds.
+     * @param timestamp The time the report was sent in the reporter's clock, in milliseconds.
+     */
+    voice_report_packet(uint32_t stream_id, uint8_t loss, uint16_t jitter, uint16_t rtt,
+                        uint32_t timestamp)
+        : _stream_id(stream_id), _loss(loss), _jitter(jitter), _rtt(rtt), _timestamp(timestamp) {}
+
+    /**
+     * Encode the packet.
+     *
+     * The packet is a fixed binary structure in network byte order: version (8 bits), loss (8
+     * bits), jitter (16 bits), stream id (32 bits), timestamp (32 bits) and RTT (16 bits). The
+     * version never matches the version of the voice packet so both can share the voice session.
+     *
+     * @return The packet encoded.
+     */
+    std::string encode() const {
+        std::string encoded_packet(VOICE_REPORT_SIZE, '\0');
+        unsigned char *buf = (unsigned char *)&encoded_packet[0];
+
+        buf[0] = VOICE_REPORT_VERSION;
+        buf[1] = _loss;
+        utils::serialization::write_uint16(buf + 2, _jitter);
+        utils::serialization::write_uint32(buf + 4, _stream_id);
+        utils::serialization::write_uint32(buf + 8, _timestamp);
+        utils::serialization::write_uint16(buf + 12, _rtt);
+
+        return encoded_packet;
+    }
+
+    /**
+     * Decode the packet.
+     *
+     * @param buf The packet's encoded data.
+     * @return True if the packet was decoded successfully or false otherwise.
+     */
+    bool decode(const std::string &buf) {
+        const unsigned char *data = (const unsigned char *)buf.data();
+
+        if (buf.length() != VOICE_REPORT_SIZE || data[0] != VOICE_REPORT_VERSION) {
+            return false;
+        }
+
+        _loss = data[1];
+        _jitter = utils::serialization::read_uint16(data + 2);
+        _stream_id = utils::serialization::read_uint32(data + 4);
+        _timestamp = utils::serialization::read_uint32(data + 8);
+        _rtt = utils::serialization::read_uint16(data + 12);
+
+        return true;
+    }
+
+    /**
+     * Get the stream id.
+     *
+     * @return The id of the reported voice stream.
+     */
+    uint32_t stream_id() const { return _stream_id; }
+
+    /**
+     * Get the loss.
+     *
+     * @return The fraction of the stream's packets that were lost, in 1/255 units.
+     */
+    uint8_t loss() const { return _loss; }
+
+    /**
+     * Get the jitter.
+     *
+     * @return The inter-arrival jitter of the stream in milliseconds.
+     */
+    uint16_t jitter() const { return _jitter; }
+
+    /**
+     * Get the RTT.
+     *
+     * @return The round trip time between the reporter and the server in milliseconds.
+     */
+    uint16_t rtt() const { return _rtt; }
+
+    /**
+     * Get the timestamp.
+     *
+     * @return The time the report was sent in the reporter's clock, in milliseconds.
+     */
+    uint32_t timestamp() const { return _timestamp; }
+
+   private:
+    uint32_t _stream_id;
+    uint8_t _loss;
+    uint16_t _jitter;
+    uint16_t _rtt;
+    uint32_t _timestamp;
+};
+};  // namespace packets
+};  // namespace quesync
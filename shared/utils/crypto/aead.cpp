@@ -0,0 +1,70 @@
+#include "aead.h"
+
+#include <openssl/evp.h>
+#include <cstring>
+
+quesync::utils::crypto::aead::aead(const unsigned char *key, uint32_t nonce_prefix)
+    : _encrypt_ctx(EVP_CIPHER_CTX_new()),
+      _decrypt_ctx(EVP_CIPHER_CTX_new()),
+      _nonce_prefix(nonce_prefix),
+      _nonce_counter(0) {
+    // Init the EVP contexts with the key, the nonce is set for each packet
+    EVP_EncryptInit_ex(_encrypt_ctx, EVP_aes_256_gcm(), NULL, NULL, NULL);
+    EVP_CIPHER_CTX_ctrl(_encrypt_ctx, EVP_CTRL_GCM_SET_IVLEN, AEAD_NONCE_SIZE, NULL);
+    EVP_EncryptInit_ex(_encrypt_ctx, NULL, NULL, key, NULL);
+
+    EVP_DecryptInit_ex(_decrypt_ctx, EVP_aes_256_gcm(), NULL, NULL, NULL);
+    EVP_CIPHER_CTX_ctrl(_decrypt_ctx, EVP_CTRL_GCM_SET_IVLEN, AEAD_NONCE_SIZE, NULL);
+    EVP_DecryptInit_ex(_decrypt_ctx, NULL, NULL, key, NULL);
+}
+
+quesync::utils::crypto::aead::~aead() {
+    // Free the EVP contexts
+    EVP_CIPHER_CTX_free(_encrypt_ctx);
+    EVP_CIPHER_CTX_free(_decrypt_ctx);
+}
+
+bool quesync::utils::crypto::aead::seal(const unsigned char *data, int len, unsigned char *nonce,
+                                        unsigned char *tag, unsigned char *out) {
+    uint64_t counter = _nonce_counter++;
+    int out_len = 0, final_len = 0;
+
+    // Format the nonce from the prefix and the counter
+    memcpy(nonce, &_nonce_prefix, sizeof(_nonce_prefix));
+    memcpy(nonce + sizeof(_nonce_prefix), &counter, sizeof(counter));
+
+    std::lock_guard lk(_encrypt_mutex);
+
+    // Encrypt the data with the nonce, the key schedule is reused
+    if (!EVP_EncryptInit_ex(_encrypt_ctx, NULL, NULL, NULL, nonce) ||
+        !EVP_EncryptUpdate(_encrypt_ctx, out, &out_len, data, len) ||
+        !EVP_EncryptFinal_ex(_encrypt_ctx, out + out_len, &final_len)) {
+        return false;
+    }
+
+    // Get the authentication tag
+    return EVP_CIPHER_CTX_ctrl(_encrypt_ctx, EVP_CTRL_GCM_GET_TAG, AEAD_TAG_SIZE, tag);
+}
+
+bool quesync::utils::crypto::aead::open(const unsigned char *data, int len,
+                                        const unsigned char *nonce, const unsigned char *tag,
+                                        unsigned char *out) {
+    int out_len = 0, final_len = 0;
+
+    // Reject nonces generated by this context, they can only be reflected packets
+    if (memcmp(nonce, &_nonce_prefix, sizeof(_nonce_prefix)) == 0) {
+        return false;
+    }
+
+    std::lock_guard lk(_decrypt_mutex);
+
+    // Decrypt the data with the nonce and set the expected tag
+    if (!EVP_DecryptInit_ex(_decrypt_ctx, NULL, NULL, NULL, nonce) ||
+        !EVP_DecryptUpdate(_decrypt_ctx, out, &out_len, data, len) ||
+        !EVP_CIPHER_CTX_ctrl(_decrypt_ctx, EVP_CTRL_GCM_SET_TAG, AEAD_TAG_SIZE, (void *)tag)) {
+        return false;
+    }
+
+    // Verify the tag
+    return EVP_DecryptFinal_ex(_decrypt_ctx, out + out_len, &final_len) > 0;
+}
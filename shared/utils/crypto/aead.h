@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#define AEAD_KEY_SIZE (256 / 8)
+#define AEAD_NONCE_SIZE 12
+#define AEAD_TAG_SIZE 16
+
+struct evp_cipher_ctx_st;
+
+namespace quesync {
+namespace utils {
+namespace crypto {
+class aead {
+   public:
+    /**
+     * AES256-GCM context constructor.
+     *
+     * @param key The key to be used for encryption and decryption.
+     * @param nonce_prefix The prefix of the nonces generated by this context. Each side sharing
+     *                     the key must use a different prefix so nonces are never reused.
+     */
+    aead(const unsigned char *key, uint32_t nonce_prefix);
+    ~aead();
+
+    /**
+     * Encrypt and authenticate data using AES256-GCM.
+     *
+     * @param data The raw data to be encrypted.
+     * @param len The length of the raw data.
+     * @param nonce A buffer of AEAD_NONCE_SIZE bytes to write the generated nonce to.
+     * @param tag A buffer of AEAD_TAG_SIZE bytes to write the authentication tag to.
+     * @param out A buffer of at least len bytes to write the encrypted data to.
+     * @return True if the data was encrypted or false otherwise.
+     */
+    bool seal(const unsigned char *data, int len, unsigned char *nonce, unsigned char *tag,
+              unsigned char *out);
+
+    /**
+     * Authenticate and decrypt data using AES256-GCM.
+     *
+     * @param data The data to be decrypted.
+     * @param len The length of the data.
+     * @param nonce The nonce the data was encrypted with.
+     * @param tag The authentication tag of the data.
+     * @param out A buffer of at least len bytes to write the raw data to.
+     * @return True if the data is authentic and was decrypted or false otherwise.
+     */
+    bool open(const unsigned char *data, int len, const unsigned char *nonce,
+              const unsigned char *tag, unsigned char *out);
+
+   private:
+    /// The EVP context used for encryption, initialized once with the key.
+    evp_cipher_ctx_st *_encrypt_ctx;
+
+    /// The EVP context used for decryption, initialized once with the key.
+    evp_cipher_ctx_st *_decrypt_ctx;
+
+    /// The prefix of the generated nonces.
+    uint32_t _nonce_prefix;
+
+    /// The counter of the generated nonces.
+    std::atomic<uint64_t> _nonce_counter;
+
+    std::mutex _encrypt_mutex;
+    std::mutex _decrypt_mutex;
+};
+};  // namespace crypto
+};  // namespace utils
+};  // namespace quesync
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 
 #include "../voice_header.h"
+#include "crypto/aead.h"
 #include "crypto/aes256.h"
 #include "crypto/base64.h"
 #include "crypto/hmac.h"
@@ -82,6 +85,188 @@ class encryption {
 
         return packet;
     }
+
+    /**
+     * Encrypts a voice packet using an AEAD context
+     *
+     * @tparam T The type of the voice packet.
+     * @param packet The packet to be encrypted.
+     * @param aead The AEAD context of the voice session.
+     * @return String with the packet's data encrypted.
+     */
+    template <typename T>
+    static std::string encrypt_voice_packet(T *packet, crypto::aead *aead) {
+        return encrypt_voice_data(packet->encode(), aead);
+    }
+
+    /**
+     * Encrypts encoded voice packet data using an AEAD context
+     *
+     * @param data The encoded packet.
+     * @param aead The AEAD context of the voice session.
+     * @return String with the packet's data encrypted, empty if the encryption failed.
+     */
+    static std::string encrypt_voice_data(const std::string &data, crypto::aead *aead) {
+        std::string encrypted;
+
+        if (!encrypt_voice_data(data.data(), data.length(), aead, encrypted)) {
+            return "";
+        }
+
+        return encrypted;
+    }
+
+    /**
+     * Encrypts encoded voice packet data using an AEAD context into a reused buffer
+     *
+     * @param data A buffer with the encoded packet.
+     * @param len The length of the buffer.
+     * @param aead The AEAD context of the voice session.
+     * @param encrypted The buffer to write the encrypted packet to, it's capacity is reused.
+     * @return True if the packet was encrypted or false otherwise.
+     */
+    static bool encrypt_voice_data(const char *data, std::size_t len, crypto::aead *aead,
+                                   std::string &encrypted) {
+        encrypted.resize(sizeof(voice::aead_header) + len);
+        voice::aead_header *voice_header = (voice::aead_header *)&encrypted[0];
+
+        // Encrypt the packet right after the voice header
+        return aead->seal((const unsigned char *)data, (int)len, voice_header->nonce,
+                          voice_header->tag,
+                          (unsigned char *)&encrypted[sizeof(voice::aead_header)]);
+    }
+
+    /**
+     * Decrypts a voice packet using an AEAD context
+     *
+     * @tparam T The type of the voice packet.
+     * @param data String with the packet's data encrypted.
+     * @param aead The AEAD context of the voice session.
+     * @return A shared pointer to the packet object.
+     */
+    template <typename T>
+    static std::shared_ptr<T> decrypt_voice_packet(const std::string &data, crypto::aead *aead) {
+        return decrypt_voice_packet<T>(data.data(), data.length(), aead);
+    }
+
+    /**
+     * Decrypts a voice packet using an AEAD context
+     *
+     * @tparam T The type of the voice packet.
+     * @param data A buffer with the packet's data encrypted.
+     * @param len The length of the buffer.
+     * @param aead The AEAD context of the voice session.
+     * @return A shared pointer to the packet object.
+     */
+    template <typename T>
+    static std::shared_ptr<T> decrypt_voice_packet(const char *data, std::size_t len,
+                                                   crypto::aead *aead) {
+        std::shared_ptr<T> packet = std::make_shared<T>();
+
+        if (!decrypt_voice_packet(data, len, aead, *packet)) {
+            return nullptr;
+        }
+
+        return packet;
+    }
+
+    /**
+     * Decrypts a voice packet using an AEAD context into an existing packet object
+     *
+     * @tparam T The type of the voice packet.
+     * @param data A buffer with the packet's data encrypted.
+     * @param len The length of the buffer.
+     * @param aead The AEAD context of the voice session.
+     * @param packet The packet object to decode the packet into, it's buffers are reused.
+     * @return True if the packet was decrypted and decoded or false otherwise.
+     */
+    template <typename T>
+    static bool decrypt_voice_packet(const char *data, std::size_t len, crypto::aead *aead,
+                                     T &packet) {
+        // The decryption buffer is reused between packets of the same thread
+        thread_local std::string decrypted;
+
+        const voice::aead_header *voice_header = (const voice::aead_header *)data;
+
+        if (len <= sizeof(voice::aead_header)) {
+            return false;
+        }
+
+        // Decrypt the packet
+        decrypted.resize(len - sizeof(voice::aead_header));
+        if (!aead->open((const unsigned char *)data + sizeof(voice::aead_header),
+                        (int)decrypted.length(), voice_header->nonce, voice_header->tag,
+                        (unsigned char *)&decrypted[0])) {
+            return false;
+        }
+
+        // Decode the packet
+        return packet.decode(decrypted);
+    }
+
+    /**
+     * Encrypts a voice packet using the group key of a voice channel
+     *
+     * @tparam T The type of the voice packet.
+     * @param packet The packet to be encrypted.
+     * @param epoch The epoch of the group key.
+     * @param aead The AEAD context of the group key.
+     * @return String with the packet's data encrypted, empty if the encryption failed.
+     */
+    template <typename T>
+    static std::string encrypt_group_voice_packet(T *packet, uint32_t epoch, crypto::aead *aead) {
+        std::string encrypted = encrypt_voice_data(packet->encode(), aead);
+
+        if (encrypted.empty()) {
+            return "";
+        }
+
+        return std::string((char *)&epoch, sizeof(epoch)) + encrypted;
+    }
+
+    /**
+     * Decrypts a voice packet using the group key of a voice channel
+     *
+     * @tparam T The type of the voice packet.
+     * @param data String with the packet's data encrypted.
+     * @param epoch The epoch of the group key.
+     * @param aead The AEAD context of the group key.
+     * @return A shared pointer to the packet object, null if it was encrypted with another epoch.
+     */
+    template <typename T>
+    static std::shared_ptr<T> decrypt_group_voice_packet(const std::string &data, uint32_t epoch,
+                                                         crypto::aead *aead) {
+        // Check the packet was encrypted with the given epoch of the group key
+        if (data.length() <= sizeof(epoch) || memcmp(data.data(), &epoch, sizeof(epoch)) != 0) {
+            return nullptr;
+        }
+
+        return decrypt_voice_packet<T>(data.data() + sizeof(epoch), data.length() - sizeof(epoch),
+                                       aead);
+    }
+
+    /**
+     * Decrypts a voice packet using the group key of a voice channel into an existing packet
+     * object
+     *
+     * @tparam T The type of the voice packet.
+     * @param data String with the packet's data encrypted.
+     * @param epoch The epoch of the group key.
+     * @param aead The AEAD context of the group key.
+     * @param packet The packet object to decode the packet into, it's buffers are reused.
+     * @return True if the packet was decrypted and decoded or false otherwise.
+     */
+    template <typename T>
+    static bool decrypt_group_voice_packet(const std::string &data, uint32_t epoch,
+                                           crypto::aead *aead, T &packet) {
+        // Check the packet was encrypted with the given epoch of the group key
+        if (data.length() <= sizeof(epoch) || memcmp(data.data(), &epoch, sizeof(epoch)) != 0) {
+            return false;
+        }
+
+        return decrypt_voice_packet(data.data() + sizeof(epoch), data.length() - sizeof(epoch),
+                                    aead, packet);
+    }
 };
 };  // namespace utils
 };  // namespace quesync
\ No newline at end of file
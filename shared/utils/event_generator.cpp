@@ -4,4 +4,5 @@ const std::unordered_map<quesync::event_type, std::function<std::shared_ptr<ques
     quesync::utils::event_generator::event_initalizers{
         EVENT_ENTRY(call_ended_event),        EVENT_ENTRY(incoming_call_event),
         EVENT_ENTRY(friend_request_event),    EVENT_ENTRY(message_event),
-        EVENT_ENTRY(friendship_status_event), EVENT_ENTRY(voice_state_event)};
\ No newline at end of file
+        EVENT_ENTRY(friendship_status_event), EVENT_ENTRY(voice_state_event),
+        EVENT_ENTRY(voice_group_key_event)};
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include "../events/friendship_status_event.h"
 #include "../events/incoming_call_event.h"
 #include "../events/message_event.h"
+#include "../events/voice_group_key_event.h"
 #include "../events/voice_state_event.h"
 
 #define EVENT_ENTRY(event_name) \
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+namespace quesync {
+namespace utils {
+class serialization {
+   public:
+    /**
+     * Writes a 16 bit integer in network byte order.
+     *
+     * @param buf The buffer to write the integer to.
+     * @param value The integer.
+     */
+    static void write_uint16(unsigned char *buf, uint16_t value) {
+        buf[0] = (unsigned char)(value >> 8);
+        buf[1] = (unsigned char)value;
+    }
+
+    /**
+     * Writes a 32 bit integer in network byte order.
+     *
+     * @param buf The buffer to write the integer to.
+     * @param value The integer.
+     */
+    static void write_uint32(unsigned char *buf, uint32_t value) {
+        write_uint16(buf, (uint16_t)(value >> 16));
+        write_uint16(buf + 2, (uint16_t)value);
+    }
+
+    /**
+     * Reads a 16 bit integer in network byte order.
+     *
+     * @param buf The buffer to read the integer from.
+     * @return The integer.
+     */
+    static uint16_t read_uint16(const unsigned char *buf) {
+        return (uint16_t)((buf[0] << 8) | buf[1]);
+    }
+
+    /**
+     * Reads a 32 bit integer in network byte order.
+     *
+     * @param buf The buffer to read the integer from.
+     * @return The integer.
+     */
+    static uint32_t read_uint32(const unsigned char *buf) {
+        return ((uint32_t)read_uint16(buf) << 16) | read_uint16(buf + 2);
+    }
+};
+};  // namespace utils
+};  // namespace quesync
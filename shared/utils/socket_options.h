@@ -0,0 +1,46 @@
+#pragma once
+
+#include <asio.hpp>
+#include <cstddef>
+
+namespace quesync {
+namespace utils {
+#ifdef SO_REUSEPORT
+/**
+ * Socket option that allows multiple sockets to be bound to the same port, the kernel spreads
+ * the incoming datagrams and connections between them.
+ */
+class reuse_port {
+   public:
+    /**
+     * @param enabled Should the option be enabled.
+     */
+    explicit reuse_port(bool enabled) : _value(enabled ? 1 : 0) {}
+
+    template <typename Protocol>
+    int level(const Protocol &) const {
+        return SOL_SOCKET;
+    }
+
+    template <typename Protocol>
+    int name(const Protocol &) const {
+        return SO_REUSEPORT;
+    }
+
+    template <typename Protocol>
+    const void *data(const Protocol &) const {
+        return &_value;
+    }
+
+    template <typename Protocol>
+    std::size_t size(const Protocol &) const {
+        return sizeof(_value);
+    }
+
+   private:
+    /// The value of the option.
+    int _value;
+};
+#endif
+};  // namespace utils
+};  // namespace quesync
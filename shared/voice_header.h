@@ -1,8 +1,18 @@
 #pragma once
 
+#include <cstdint>
+
+#include "utils/crypto/aead.h"
 #include "utils/crypto/aes256.h"
 #include "utils/crypto/hmac.h"
 
+#define VOICE_CIPHER_CBC_HMAC "aes-256-cbc-hmac-sha1"
+#define VOICE_CIPHER_GCM "aes-256-gcm"
+
+#define VOICE_CLIENT_NONCE_PREFIX 1
+#define VOICE_SERVER_NONCE_PREFIX 2
+#define VOICE_GROUP_NONCE_PREFIX_BASE 0x100
+
 namespace quesync {
 namespace voice {
 struct header {
@@ -12,5 +22,21 @@ struct header {
     /// The HMAC of the data.
     unsigned char hmac[HMAC_KEY_SIZE];
 };
+
+struct aead_header {
+    /// The nonce the data was encrypted with.
+    unsigned char nonce[AEAD_NONCE_SIZE];
+
+    /// The authentication tag of the data.
+    unsigned char tag[AEAD_TAG_SIZE];
+};
+
+struct group_header {
+    /// The epoch of the group key the data was encrypted with.
+    uint32_t epoch;
+
+    /// The AEAD header of the data.
+    aead_header aead;
+};
 };  // namespace voice
 };  // namespace quesync
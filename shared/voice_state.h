@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <ctime>
 #include <nlohmann/json.hpp>
 
@@ -23,7 +24,8 @@ class state {
         : _voice_state(voice_state),
           _state_change_time(std::time(nullptr)),
           _muted(muted),
-          _deafen(deafen) {}
+          _deafen(deafen),
+          _stream_id(0) {}
 
     state &operator=(state_type voice_state) {
         _voice_state = voice_state;
@@ -82,22 +84,40 @@ class state {
      */
     void undeaf() { _deafen = false; }
 
+    /**
+     * Get the id of the user's voice stream.
+     *
+     * @return The id of the voice stream, 0 if the user has no voice stream.
+     */
+    uint32_t stream_id() const { return _stream_id; }
+
+    /**
+     * Set the id of the user's voice stream.
+     *
+     * @param stream_id The id of the voice stream.
+     */
+    void set_stream_id(uint32_t stream_id) { _stream_id = stream_id; }
+
    private:
     state_type _voice_state;
     std::time_t _state_change_time;
 
     bool _muted;
     bool _deafen;
+
+    uint32_t _stream_id;
 };
 
 inline void to_json(nlohmann::json &j, const state &voice_state) {
     j = nlohmann::json{{"state", (int)voice_state.voice_state()},
                        {"muted", voice_state.muted()},
-                       {"deafen", voice_state.deafen()}};
+                       {"deafen", voice_state.deafen()},
+                       {"streamId", voice_state.stream_id()}};
 }
 
 inline void from_json(const nlohmann::json &j, state &voice_state) {
     voice_state = state(j["state"], j["muted"], j["deafen"]);
+    voice_state.set_stream_id(j.value("streamId", 0u));
 }
 };  // namespace voice
 };  // namespace quesync
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+
+namespace quesync {
+namespace voice {
+struct stream_stats {
+    /// The id of the voice stream.
+    uint32_t stream_id = 0;
+
+    /// The id of the user that owns the voice stream.
+    std::string user_id;
+
+    /// The amount of packets and bytes received of the stream.
+    uint64_t packets_in = 0;
+    uint64_t bytes_in = 0;
+
+    /// The amount of packets and bytes sent of the stream.
+    uint64_t packets_out = 0;
+    uint64_t bytes_out = 0;
+
+    /// The amount of packets that never arrived.
+    uint64_t lost = 0;
+
+    /// The amount of packets that arrived after a later packet.
+    uint64_t reordered = 0;
+
+    /// The estimated inter-arrival jitter in milliseconds.
+    double jitter = 0;
+
+    /// The amount of frames waiting in the jitter buffer.
+    unsigned int buffer_depth = 0;
+
+    /// The average time it took to encode or decode a packet in microseconds.
+    double codec_time = 0;
+
+    /// The average time from receiving a packet to forwarding it in microseconds.
+    double relay_latency = 0;
+};
+
+inline void to_json(nlohmann::json &j, const stream_stats &s) {
+    j = {{"streamId", s.stream_id},
+         {"userId", s.user_id},
+         {"packetsIn", s.packets_in},
+         {"bytesIn", s.bytes_in},
+         {"packetsOut", s.packets_out},
+         {"bytesOut", s.bytes_out},
+         {"lost", s.lost},
+         {"reordered", s.reordered},
+         {"jitter", s.jitter},
+         {"bufferDepth", s.buffer_depth},
+         {"codecTime", s.codec_time},
+         {"relayLatency", s.relay_latency}};
+}
+
+inline void from_json(const nlohmann::json &j, stream_stats &s) {
+    s.stream_id = j["streamId"];
+    s.user_id = j["userId"];
+    s.packets_in = j["packetsIn"];
+    s.bytes_in = j["bytesIn"];
+    s.packets_out = j["packetsOut"];
+    s.bytes_out = j["bytesOut"];
+    s.lost = j["lost"];
+    s.reordered = j["reordered"];
+    s.jitter = j["jitter"];
+    s.buffer_depth = j["bufferDepth"];
+    s.codec_time = j["codecTime"];
+    s.relay_latency = j["relayLatency"];
+}
+};  // namespace voice
+};  // namespace quesync